@@ -0,0 +1,79 @@
+#include "pch.h"
+#include "pixel_converter.h"
+
+// Проверяет результат преобразования пикселей по попиксельной эталонной формуле
+static bool checkConversion(int count, bool opaque, bool premultiply)
+{
+	QVector<quint32> src(count), dst(count);
+	for (int i = 0; i < count; ++i)
+		src[i] = (quint32(qrand()) << 16) ^ quint32(qrand());
+	PixelConverter::convertToRGBA(src.constData(), dst.data(), count, opaque, premultiply);
+
+	for (int i = 0; i < count; ++i)
+	{
+		quint32 pixel = opaque ? src[i] | 0xFF000000 : src[i];
+		quint32 a = pixel >> 24, r = (pixel >> 16) & 0xFF, g = (pixel >> 8) & 0xFF, b = pixel & 0xFF;
+		if (premultiply && !opaque)
+		{
+			r = (r * a * 2 + 255) / 510;
+			g = (g * a * 2 + 255) / 510;
+			b = (b * a * 2 + 255) / 510;
+		}
+		if (dst[i] != (r | (g << 8) | (b << 16) | (a << 24)))
+			return false;
+	}
+	return true;
+}
+
+// Возвращает лучшее время преобразования изображения в миллисекундах: через QGLWidget::convertToGLFormat или на месте
+static double measureConversion(const QImage &source, int numRuns, bool inPlace, bool premultiply)
+{
+	qint64 best = -1;
+	for (int i = 0; i < numRuns; ++i)
+	{
+		// копия для преобразования на месте создается вне замера, так как декодированное изображение уже принадлежит загрузчику
+		QImage image = source.copy();
+		QElapsedTimer timer;
+		timer.start();
+		if (inPlace)
+			PixelConverter::convertToRGBA(reinterpret_cast<const quint32 *>(image.constBits()), reinterpret_cast<quint32 *>(image.bits()),
+				image.width() * image.height(), false, premultiply);
+		else
+			image = QGLWidget::convertToGLFormat(image);
+		qint64 elapsed = timer.nsecsElapsed();
+		best = best < 0 ? elapsed : qMin(best, elapsed);
+	}
+	return best / 1000000.0;
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication app(argc, argv);
+
+	// параметры: размер стороны изображения и количество повторов
+	QStringList arguments = app.arguments();
+	int size = arguments.size() > 1 ? arguments[1].toInt() : 4096;
+	int numRuns = arguments.size() > 2 ? arguments[2].toInt() : 10;
+
+	// проверяем все режимы на количестве пикселей, не кратном ширине векторных регистров
+	QTextStream out(stdout);
+	for (int opaque = 0; opaque < 2; ++opaque)
+		for (int premultiply = 0; premultiply < 2; ++premultiply)
+			if (!checkConversion(1027, opaque != 0, premultiply != 0))
+			{
+				out << "Conversion mismatch, opaque = " << opaque << ", premultiply = " << premultiply << endl;
+				return 1;
+			}
+
+	// заполняем изображение случайными пикселями
+	QImage image(size, size, QImage::Format_ARGB32);
+	quint32 *pixels = reinterpret_cast<quint32 *>(image.bits());
+	for (int i = 0; i < size * size; ++i)
+		pixels[i] = (quint32(qrand()) << 16) ^ quint32(qrand());
+
+	out << "Image " << size << "x" << size << ", best of " << numRuns << " runs" << endl;
+	out << "QGLWidget::convertToGLFormat:          " << measureConversion(image, numRuns, false, false) << " ms" << endl;
+	out << "PixelConverter in place, straight:     " << measureConversion(image, numRuns, true, false) << " ms" << endl;
+	out << "PixelConverter in place, premultiplied: " << measureConversion(image, numRuns, true, true) << " ms" << endl;
+	return 0;
+}
@@ -0,0 +1,98 @@
+#include "pch.h"
+#include "directory_cache.h"
+#include "options.h"
+#include "project.h"
+#include "scene.h"
+
+// Записывает сгенерированную сцену с заданным количеством спрайтов и надписей в формате редактора
+static bool generateScene(const QString &fileName, int numObjects, int objectsPerLayer)
+{
+	QFile file(fileName);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+		return false;
+
+	QTextStream stream(&file);
+	stream.setCodec("UTF-8");
+	stream << "return\n{\n\tlayers =\n\t{type = \"LayerGroup\", name = \"\", visibleState = 0, lockState = 0, expanded = false,\n";
+
+	int numLayers = (numObjects + objectsPerLayer - 1) / objectsPerLayer;
+	for (int layer = 0, id = 1; layer < numLayers; ++layer)
+	{
+		stream << "\t\t{type = \"Layer\", name = \"Слой " << layer + 1 << "\", visibleState = 0, lockState = 0, expanded = false,\n";
+		int count = qMin(objectsPerLayer, numObjects - layer * objectsPerLayer);
+		for (int i = 0; i < count; ++i, ++id)
+		{
+			// чередуем спрайты и надписи со случайными координатами
+			int x = qrand() % 4096, y = qrand() % 4096;
+			if (id % 2 != 0)
+				stream << "\t\t\t{type = \"Sprite\", name = \"Спрайт " << id << "\", id = " << id << ", posX = " << x << ", posY = " << y
+					<< ", width = 64, height = 64, angle = 0, centerX = 0.5, centerY = 0.5, fileName = \"sprites/sprite_" << id % 100
+					<< ".png\", textureWidth = 64, textureHeight = 64, color = 0xFFFFFFFF}";
+			else
+				stream << "\t\t\t{type = \"Label\", name = \"Текст " << id << "\", id = " << id << ", posX = " << x << ", posY = " << y
+					<< ", width = 200, height = 40, angle = 0, centerX = 0.5, centerY = 0.5, text = \"Надпись " << id
+					<< "\", fileName = \"fonts/font.ttf\", size = 32, horzAlignment = 0, vertAlignment = 0, lineSpacing = 1, color = 0xFFFFFFFF}";
+			stream << (i + 1 < count ? ",\n" : "\n");
+		}
+		stream << (layer + 1 < numLayers ? "\t\t},\n" : "\t\t}\n");
+	}
+
+	stream << "\t},\n\tactiveLayer = {0},\n\tobjectIndex = " << numObjects + 1 << ",\n\tlayerIndex = " << numLayers + 1
+		<< ",\n\tlayerGroupIndex = 1,\n\tspriteIndex = 1,\n\tlabelIndex = 1,\n\thorzGuides = {},\n\tvertGuides = {}\n}\n";
+	stream.flush();
+	return stream.status() == QTextStream::Ok;
+}
+
+int main(int argc, char **argv)
+{
+	QCoreApplication app(argc, argv);
+	QTextCodec::setCodecForCStrings(QTextCodec::codecForName("UTF-8"));
+	QTextCodec::setCodecForLocale(QTextCodec::codecForName("UTF-8"));
+
+	// параметры: количество объектов и количество повторов
+	QStringList arguments = app.arguments();
+	int numObjects = arguments.size() > 1 ? arguments[1].toInt() : 100000;
+	int numRuns = arguments.size() > 2 ? arguments[2].toInt() : 5;
+
+	// создаем синглетоны, используемые при разборе сцены; ресурсы объектов при разборе не загружаются
+	QSettings settings(QDir::temp().filePath("scene_benchmark.ini"), QSettings::IniFormat);
+	new Options(settings);
+	new DirectoryCache();
+	new Project();
+
+	// генерируем сцену во временном каталоге, где нет ее бинарного кэша
+	QString fileName = QDir::temp().filePath("scene_benchmark.lua");
+	QFile::remove(fileName + ".cache");
+	QTextStream out(stdout);
+	if (!generateScene(fileName, numObjects, 1000))
+	{
+		out << "Failed to write " << fileName << endl;
+		return 1;
+	}
+	out << "Generated " << numObjects << " objects, " << QFileInfo(fileName).size() << " bytes" << endl;
+
+	// разбираем сцену несколько раз и выводим лучшее и среднее время
+	qint64 best = -1, total = 0;
+	for (int i = 0; i < numRuns; ++i)
+	{
+		QElapsedTimer timer;
+		timer.start();
+		QByteArray data = Scene::parse(fileName);
+		qint64 elapsed = timer.elapsed();
+		if (data.isEmpty())
+		{
+			out << "Failed to parse " << fileName << endl;
+			return 1;
+		}
+		best = best < 0 ? elapsed : qMin(best, elapsed);
+		total += elapsed;
+		out << "Run " << i + 1 << ": " << elapsed << " ms, " << data.size() << " bytes of parsed data" << endl;
+	}
+	out << "Best " << best << " ms, average " << total / qMax(numRuns, 1) << " ms" << endl;
+
+	QFile::remove(fileName);
+	Project::destroy();
+	DirectoryCache::destroy();
+	Options::destroy();
+	return 0;
+}
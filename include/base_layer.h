@@ -1,8 +1,11 @@
 #ifndef BASE_LAYER_H
 #define BASE_LAYER_H
 
+#include "name_index.h"
+
 class GameObject;
 class LuaScript;
+class SpriteBatch;
 class Texture;
 
 // Базовый класс слоя
@@ -101,6 +104,27 @@ public:
 	// Удаляет дочерний слой
 	void removeChildLayer(int index);
 
+	// Ищет игровой объект по заданному имени в слое и его дочерних слоях
+	GameObject *findGameObjectByName(const QString &name) const;
+
+	// Возвращает наименьший номер копии не меньше заданного, не занятый именами игровых объектов всего дерева слоев с заданной базовой частью
+	int findFreeCopyIndex(const QString &baseName, int index) const;
+
+	// Сбрасывает кэшированный ограничивающий прямоугольник слоя и всех родительских слоев
+	void invalidateBoundingRect();
+
+	// Возвращает ключ слоя в истории отмен
+	quint32 getUndoKey() const;
+
+	// Устанавливает ключ слоя в истории отмен
+	void setUndoKey(quint32 key);
+
+	// Проверяет, изменились ли свойства или список дочерних элементов слоя с момента последней записи в историю отмен
+	bool isUndoDirty() const;
+
+	// Устанавливает/сбрасывает флаг изменения слоя с момента последней записи в историю отмен
+	void setUndoDirty(bool dirty);
+
 	// Загружает слой из бинарного потока
 	virtual bool load(QDataStream &stream);
 
@@ -119,11 +143,14 @@ public:
 	// Возвращает список всех игровых объектов
 	virtual QList<GameObject *> getGameObjects() const = 0;
 
+	// Возвращает количество всех игровых объектов
+	virtual int getNumGameObjects() const = 0;
+
 	// Ищет все активные игровые объекты
 	virtual QList<GameObject *> findActiveGameObjects() const = 0;
 
-	// Рекурсивно ищет игровой объект по заданному имени
-	virtual GameObject *findGameObjectByName(const QString &name) const = 0;
+	// Ищет все видимые игровые объекты
+	virtual QList<GameObject *> findVisibleGameObjects() const = 0;
 
 	// Ищет игровой объект, содержащий заданную точку
 	virtual GameObject *findGameObjectByPoint(const QPointF &pt) const = 0;
@@ -140,8 +167,8 @@ public:
 	// Привязывает координату по оси Y к игровым объектам
 	virtual void snapYCoord(qreal y, qreal x1, qreal x2, const QList<GameObject *> &excludedObjects, qreal &snappedY, qreal &distance, QLineF &line) const = 0;
 
-	// Устанавливает текущий язык для слоя
-	virtual void setCurrentLanguage(const QString &language) = 0;
+	// Переключает на текущий язык объекты слоя, язык которых устарел; возвращает true, если объекты изменились
+	virtual bool updateCurrentLanguage() = 0;
 
 	// Загружает переводы из Lua скрипта
 	virtual void loadTranslations(LuaScript *script) = 0;
@@ -155,11 +182,17 @@ public:
 	// Заменяет текстуру в слое
 	virtual QList<GameObject *> changeTexture(const QString &fileName, const QSharedPointer<Texture> &texture) = 0;
 
-	// Отрисовывает слой
-	virtual void draw(bool ignoreVisibleState = false) = 0;
+	// Отрисовывает часть слоя, попадающую в видимую область
+	virtual void draw(SpriteBatch &batch, const QRectF &visibleRect, bool ignoreVisibleState = false) = 0;
 
 protected:
 
+	// Возвращает индекс имен игровых объектов дерева слоев, который хранится в корневом слое дерева
+	NameIndex &getTreeNameIndex();
+
+	// Возвращает индекс имен игровых объектов дерева слоев, который хранится в корневом слое дерева
+	const NameIndex &getTreeNameIndex() const;
+
 	QString             mName;          // Имя (текстовое описание) слоя
 	VisibleState        mVisibleState;  // Состояние видимости слоя
 	LockState           mLockState;     // Состояние блокировки слоя
@@ -167,6 +200,18 @@ protected:
 	QIcon               mThumbnail;     // Иконка предпросмотра
 	BaseLayer           *mParentLayer;  // Указатель на родительский слой
 	QList<BaseLayer *>  mChildLayers;   // Список дочерних слоев
+	quint32             mUndoKey;       // Ключ слоя в истории отмен
+	bool                mUndoDirty;     // Флаг изменения слоя с момента последней записи в историю отмен
+
+	mutable QRectF      mBoundingRect;      // Кэшированный ограничивающий прямоугольник слоя
+	mutable bool        mBoundingRectValid; // Флаг актуальности ограничивающего прямоугольника
+
+private:
+
+	// Отсоединяет дочерний слой, не перенося игровые объекты его поддерева между индексами имен
+	void detachChildLayer(int index);
+
+	NameIndex           mNameIndex;     // Индекс имен игровых объектов поддерева, пока слой является корневым
 };
 
 #endif // BASE_LAYER_H
@@ -0,0 +1,58 @@
+#ifndef DIRECTORY_CACHE_H
+#define DIRECTORY_CACHE_H
+
+#include "singleton.h"
+
+// Глобальный класс кэша содержимого каталогов для быстрой проверки существования файлов с учетом регистра
+class DirectoryCache : public Singleton<DirectoryCache>
+{
+	Q_OBJECT
+
+public:
+
+	// Конструктор
+	DirectoryCache();
+
+	// Проверяет, что файл существует с точностью до регистра символов, может вызываться из рабочих потоков
+	bool fileExists(const QString &path);
+
+	// Сбрасывает закэшированное содержимое каталога
+	void invalidate(const QString &directory);
+
+protected:
+
+	// Вызывается по срабатыванию таймера
+	virtual void timerEvent(QTimerEvent *event);
+
+private slots:
+
+	// Ставит на слежение каталог, прочитанный в рабочем потоке
+	void onDirectoryRead(const QString &directory);
+
+	// Обработчик изменения содержимого каталога
+	void onDirectoryChanged(const QString &path);
+
+private:
+
+	static const int PRUNE_INTERVAL = 30000;    // Интервал удаления из кэша каталогов, к которым не было обращений, в миллисекундах
+
+	// Структура с информацией о каталоге
+	struct DirectoryInfo
+	{
+		QSet<QString>       mFileNames; // Множество имен файлов в каталоге
+		mutable QAtomicInt  mUsed;      // Флаг обращения к каталогу с момента последней очистки кэша
+	};
+
+	// Читает множество имен файлов каталога
+	static QSet<QString> readDirectory(const QDir &dir);
+
+	// Снимает каталог со слежения
+	void unwatchDirectory(const QString &directory);
+
+	QHash<QString, DirectoryInfo>   mDirectories;           // Содержимое каталогов по абсолютным путям каталогов
+	QSet<QString>                   mWatchedDirectories;    // Каталоги на слежении
+	QFileSystemWatcher              *mWatcher;              // Объект слежения за закэшированными каталогами
+	QReadWriteLock                  mLock;                  // Блокировка кэша для рабочих потоков
+};
+
+#endif // DIRECTORY_CACHE_H
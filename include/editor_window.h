@@ -1,6 +1,10 @@
 #ifndef EDITOR_WINDOW_H
 #define EDITOR_WINDOW_H
 
+#include "snap_index.h"
+#include "sprite_batch.h"
+#include "texture_manager.h"
+
 class BaseLayer;
 class GameObject;
 class Scene;
@@ -16,8 +20,14 @@ public:
 	// Конструктор
 	EditorWindow(QWidget *parent, QGLWidget *shareWidget, const QString &fileName, QWidget *spriteWidget, QWidget *fontWidget);
 
-	// Загружает сцену из файла
-	bool load(const QString &fileName);
+	// Деструктор
+	virtual ~EditorWindow();
+
+	// Загружает сцену файла из бинарного представления, созданного Scene::parse
+	bool load(const QString &fileName, const QByteArray &data);
+
+	// Восстанавливает измененную сцену файла из бинарного представления файла восстановления
+	bool recover(const QString &fileName, bool untitled, const QByteArray &data);
 
 	// Сохраняет сцену в файл
 	bool save(const QString &fileName);
@@ -25,6 +35,9 @@ public:
 	// Загружает файл переводов
 	bool loadTranslationFile(const QString &fileName);
 
+	// Загружает переводы из файла только для заданных объектов
+	bool loadTranslationFile(const QString &fileName, const QList<GameObject *> &objects);
+
 	// Возвращает указатель на редактируемую сцену
 	Scene *getScene() const;
 
@@ -40,6 +53,9 @@ public:
 	// Возвращает стек отмен сцены
 	QUndoStack *getUndoStack() const;
 
+	// Возвращает объем памяти, занимаемый историей отмен сцены, в байтах
+	qint64 getUndoMemoryUsage() const;
+
 	// Помещает в стек отмен новую команду
 	void pushCommand(const QString &commandName);
 
@@ -97,14 +113,14 @@ public:
 	// Перемещает выделенные объекты вниз
 	void moveDown();
 
-	// Устанавливает текущий язык
-	void setCurrentLanguage(const QString &language);
+	// Переключает сцену на текущий язык проекта, если он сменился с момента последнего переключения
+	void updateCurrentLanguage();
 
 	// Возвращает список отсутствующих файлов в сцене
 	QStringList getMissedFiles() const;
 
-	// Заменяет текстуру в сцене
-	void changeTexture(const QString &fileName, const QSharedPointer<Texture> &texture);
+	// Заменяет текстуры в сцене; возвращает true, если изменились объекты, а не только заглушки текстур
+	bool changeTextures(const TextureManager::TextureMap &textures);
 
 	// Обновляет прямоугольник выделения и центр вращения
 	void updateSelection(const QPointF &rotationCenter);
@@ -112,6 +128,12 @@ public:
 	// Обновляет разрешенные операции редактирования
 	void updateAllowedEditorActions();
 
+	// Возвращает количество объектов, отброшенных при последней отрисовке сцены, включая объекты в кэше неподвижной части сцены
+	int getNumCulledObjects() const;
+
+	// Помечает окно для перерисовки с учетом ограничения частоты кадров при перетаскивании
+	void invalidate();
+
 signals:
 
 	// Сигнал об изменении масштаба
@@ -164,6 +186,11 @@ protected:
 	// Вызывается при бросании объекта в окно редактора
 	virtual void dropEvent(QDropEvent *event);
 
+private slots:
+
+	// Обработчик изменения текущей команды в стеке отмен сцены
+	void onSceneUndoCommandChanged();
+
 private:
 
 	static const int MIN_GRID_SPACING = 10;     // Минимальный шаг сетки в пикселях
@@ -203,6 +230,9 @@ private:
 		MARKER_TOP_CENTER
 	};
 
+	// Указатель на функцию glBlendFuncSeparate из OpenGL 1.4
+	typedef void (APIENTRY *BlendFuncSeparateProc)(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha);
+
 	// Конвертирует мировые координаты в оконные
 	QPointF worldToWindow(const QPointF &pt) const;
 
@@ -260,10 +290,38 @@ private:
 	// Рисует линию привязки
 	void drawSnapLine(const QLineF &line, QPainter &painter);
 
+	// Проверяет, перетаскиваются ли выделенные объекты
+	bool isDraggingSelection() const;
+
+	// Очищает окно и рисует сетку
+	void drawBackground(const QRectF &visibleRect);
+
+	// Рисует игровые объекты из списка от нижнего к верхнему
+	void drawGameObjects(const QList<GameObject *> &objects, const QRectF &visibleRect);
+
+	// Рисует содержимое кадрового буфера на всю видимую область
+	void drawFramebuffer(QGLFramebufferObject *buffer, const QRectF &visibleRect, bool premultipliedAlpha);
+
+	// Проверяет актуальность кэша неподвижной части сцены для текущей камеры
+	bool isSelectionCacheValid() const;
+
+	// Рисует неподвижную часть сцены под и над выделенными объектами в кадровые буферы
+	bool createSelectionCache(const QRectF &visibleRect);
+
+	// Помечает кэш неподвижной части сцены как устаревший
+	void invalidateSelectionCache();
+
+	// Удаляет кэш неподвижной части сцены
+	void releaseSelectionCache();
+
+	// Возвращает индекс краев объектов для привязки, строя его при первом обращении во время перетаскивания
+	const SnapIndex &getSnapIndex();
+
 	Scene               *mScene;            // Указатель на объект сцены
 	QString             mFileName;          // Имя файла сцены
 	bool                mUntitled;          // Флаг безымянной сцены
 	EditorState         mEditorState;       // Текущее состояние редактирования
+	int                 mLanguageVersion;   // Версия языка, на который переключена сцена
 
 	bool                mEditEnabled;       // Флаг разрешения редактирования
 	bool                mMoveEnabled;       // Флаг разрешения перемещения
@@ -277,6 +335,9 @@ private:
 	QPoint              mLastPos;           // Последние оконные координаты мыши
 	QRectF              mSelectionRect;     // Рамка выделения
 	QFont               mRulerFont;         // Шрифт для подписей на линейках
+	SpriteBatch         mSpriteBatch;       // Пакет для отрисовки спрайтов сцены
+	QTimer              *mRepaintTimer;     // Таймер отложенной перерисовки при перетаскивании
+	QElapsedTimer       mFrameTimer;        // Таймер для отсчета времени с момента последней перерисовки
 
 	QList<GameObject *> mSelectedObjects;   // Список выделенных объектов
 	QList<QPointF>      mOriginalPositions; // Список исходных координат объектов
@@ -295,6 +356,19 @@ private:
 	qreal               mGuideIndex;        // Индекс текущей направляющей
 	QLineF              mHorzSnapLine;      // Горизонтальная линия привязки
 	QLineF              mVertSnapLine;      // Вертикальная линия привязки
+	SnapIndex           mSnapIndex;         // Индекс краев объектов для привязки при перетаскивании
+	QSet<GameObject *>  mSnapExcludedObjects; // Выделенные объекты, исключенные из привязки
+
+	QGLFramebufferObject    *mBelowSelectionBuffer;     // Кэш фона и объектов под выделенными объектами
+	QGLFramebufferObject    *mAboveSelectionBuffer;     // Кэш объектов над выделенными объектами
+	QList<GameObject *>     mSelectionRangeObjects;     // Объекты от верхнего до нижнего выделенного объекта
+	QList<GameObject *>     mAboveSelectionObjects;     // Объекты над выделением, не попавшие в кэш
+	bool                    mSelectionCacheValid;       // Флаг актуальности кэша
+	QPointF                 mSelectionCacheCameraPos;   // Положение камеры при создании кэша
+	qreal                   mSelectionCacheZoom;        // Зум при создании кэша
+	QSize                   mSelectionCacheSize;        // Размер окна при создании кэша
+	int                     mSelectionCacheCulledObjects; // Количество объектов, отброшенных при создании кэша
+	BlendFuncSeparateProc   mBlendFuncSeparate;         // Указатель на функцию glBlendFuncSeparate
 
 	QWidget             *mSpriteWidget;     // Указатель на виджет спрайтов для перетаскивания
 	QWidget             *mFontWidget;       // Указатель на виджет шрифтов для перетаскивания
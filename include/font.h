@@ -1,16 +1,15 @@
 #ifndef FONT_H
 #define FONT_H
 
+#include "font_file.h"
+
 // Класс шрифта
 class Font
 {
 public:
 
 	// Конструктор
-	Font();
-
-	// Конструктор
-	Font(const QString &fileName, int size);
+	Font(const QSharedPointer<FontFile> &file, int size, bool defaultFont = false);
 
 	// Деструктор
 	~Font();
@@ -30,15 +29,18 @@ public:
 	// Рисует однострочный текст
 	void draw(const QString &text);
 
+	// Рисует однострочный текст, заранее преобразованный в широкую строку
+	void draw(const std::wstring &text);
+
 private:
 
-	// Загружает шрифт из файла
-	void load(const QString &fileName, int size);
+	// Загружает шрифт заданного размера из файла шрифта
+	void load(int size);
 
-	FTFont      *mFont;         // Указатель на объект шрифта
-	QByteArray  mFontBuffer;    // Буфер в памяти для шрифта
-	qreal       mHeight;        // Высота шрифта в пикселях, полученная от FreeType
-	bool        mDefault;       // Флаг шрифта по умолчанию
+	FTFont                      *mFont;     // Указатель на объект шрифта
+	QSharedPointer<FontFile>    mFile;      // Разделяемый файл шрифта, данные которого использует FTGL
+	qreal                       mHeight;    // Высота шрифта в пикселях, полученная от FreeType
+	bool                        mDefault;   // Флаг шрифта по умолчанию
 };
 
 #endif // FONT_H
@@ -0,0 +1,40 @@
+#ifndef FONT_FILE_H
+#define FONT_FILE_H
+
+// Класс файла шрифта, загруженного в память и разделяемого шрифтами всех размеров
+class FontFile
+{
+public:
+
+	// Конструктор
+	FontFile(const QString &fileName, const QSharedPointer<FT_LibraryRec_> &library);
+
+	// Деструктор
+	~FontFile();
+
+	// Проверяет, что файл шрифта загружен
+	bool isLoaded() const;
+
+	// Возвращает полный путь к файлу шрифта
+	QString getFileName() const;
+
+	// Возвращает указатель на данные файла
+	const uchar *getData() const;
+
+	// Возвращает размер данных файла в байтах
+	qint64 getSize() const;
+
+	// Возвращает высоту шрифта заданного размера в пикселях
+	qreal getHeight(int size);
+
+private:
+
+	QSharedPointer<FT_LibraryRec_>  mLibrary;   // Библиотека FreeType, в которой создана гарнитура
+	QString                         mFileName;  // Полный путь к файлу шрифта
+	QByteArray                      mBuffer;    // Данные файла; файл не отображается в память, чтобы его изменение на диске не влияло на шрифт
+	const uchar                     *mData;     // Указатель на данные файла
+	qint64                          mSize;      // Размер данных файла в байтах
+	FT_Face                         mFace;      // Гарнитура FreeType для получения метрик шрифта
+};
+
+#endif // FONT_FILE_H
@@ -14,33 +14,84 @@ public:
 	// Конструктор
 	FontManager(QGLWidget *primaryGLWidget);
 
+	// Деструктор
+	virtual ~FontManager();
+
 	// Загружает шрифт и возвращает указатель на него
 	QSharedPointer<Font> loadFont(const QString &fileName, int size, bool useDefaultFont = true);
 
 	// Устанавливает текущий контекст OpenGL
 	void makeCurrent();
 
+	// Возвращает количество запросов шрифтов, найденных в кэше
+	int getNumHits() const;
+
+	// Возвращает количество запросов шрифтов, потребовавших создания нового шрифта
+	int getNumMisses() const;
+
+	// Возвращает количество неиспользуемых шрифтов, удаленных из кэша
+	int getNumEvictions() const;
+
+protected:
+
+	// Вызывается по срабатыванию таймера
+	virtual void timerEvent(QTimerEvent *event);
+
+private slots:
+
+	// Обработчик изменения файла шрифта на диске
+	void onFontFileChanged(const QString &path);
+
 private:
 
+	// Тип для ключа шрифта: относительное имя файла и размер в пунктах
+	typedef QPair<QString, int> FontKey;
+
 	// Структура с информацией о шрифте
 	struct FontInfo
 	{
 		// Конструктор
-		FontInfo(const QString &fileName, int size, const QSharedPointer<Font> &font)
-		: mFileName(fileName), mSize(size), mFont(font)
+		FontInfo()
+		: mUnusedFont(NULL)
 		{
 		}
 
-		QString             mFileName;  // Имя файла со шрифтом
-		int                 mSize;      // Размер шрифта в пунктах
-		QWeakPointer<Font>  mFont;      // Слабая ссылка на объект шрифта
+		QWeakPointer<Font>  mFont;          // Слабая ссылка на используемый объект шрифта
+		Font                *mUnusedFont;   // Неиспользуемый объект шрифта, удерживаемый в кэше
+		QElapsedTimer       mTimer;         // Таймер для отсчета времени с момента освобождения шрифта
 	};
 
 	// Тип для шрифтового кэша
-	typedef QList<FontInfo> FontCache;
+	typedef QHash<FontKey, FontInfo> FontCache;
+
+	// Тип для кэша файлов шрифтов
+	typedef QHash<QString, QWeakPointer<FontFile> > FontFileCache;
+
+	// Загружает файл шрифта или возвращает уже загруженный файл, разделяемый шрифтами всех размеров
+	QSharedPointer<FontFile> loadFontFile(const QString &path);
+
+	// Удаляет объект шрифта, когда его освобождает последний пользователь, либо оставляет его в кэше
+	static void releaseFont(Font *font);
+
+	// Удаляет файл шрифта, когда его освобождает последний шрифт, вместе с записью в кэше файлов шрифтов
+	static void releaseFontFile(FontFile *file);
+
+	// Помещает освобожденный шрифт в кэш неиспользуемых шрифтов
+	void retainFont(Font *font);
+
+	// Удаляет из кэша самый давно освобожденный неиспользуемый шрифт
+	void evictFont();
 
-	QGLWidget   *mPrimaryGLWidget;  // OpenGL виджет для загрузки текстур в главном потоке
-	FontCache   mFontCache;         // Шрифтовый кэш
+	QGLWidget                       *mPrimaryGLWidget;  // OpenGL виджет для загрузки текстур в главном потоке
+	QSharedPointer<FT_LibraryRec_>  mLibrary;           // Общая библиотека FreeType, освобождаемая вместе с последним файлом шрифта
+	FontCache                       mFontCache;         // Шрифтовый кэш
+	QHash<Font *, FontKey>          mFontKeys;          // Ключи шрифтов, созданных через кэш
+	QList<FontKey>                  mUnusedFonts;       // Ключи неиспользуемых шрифтов в порядке освобождения
+	FontFileCache                   mFontFileCache;     // Кэш загруженных файлов шрифтов по полным путям
+	QFileSystemWatcher              *mWatcher;          // Объект слежения за загруженными файлами шрифтов
+	int                             mNumHits;           // Количество попаданий в кэш
+	int                             mNumMisses;         // Количество промахов кэша
+	int                             mNumEvictions;      // Количество удаленных из кэша неиспользуемых шрифтов
 };
 
 #endif // FONT_MANAGER_H
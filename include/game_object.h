@@ -1,8 +1,11 @@
 #ifndef GAME_OBJECT_H
 #define GAME_OBJECT_H
 
+#include "localized_array.h"
+
 class Layer;
 class LuaScript;
+class SpriteBatch;
 class Texture;
 
 // Базовый класс игрового объекта
@@ -67,9 +70,24 @@ public:
 	// Устанавливает родительский слой
 	void setParentLayer(Layer *parent);
 
+	// Возвращает ключ объекта в истории отмен
+	quint32 getUndoKey() const;
+
+	// Устанавливает ключ объекта в истории отмен
+	void setUndoKey(quint32 key);
+
+	// Проверяет, изменился ли объект с момента последней записи в историю отмен
+	bool isUndoDirty() const;
+
+	// Устанавливает/сбрасывает флаг изменения объекта с момента последней записи в историю отмен
+	void setUndoDirty(bool dirty);
+
 	// Возвращает ограничивающий прямоугольник объекта
 	QRectF getBoundingRect() const;
 
+	// Возвращает прямоугольник, в который попадает все отрисовываемое объектом, для отсечения по видимой области
+	virtual QRectF getDrawingRect() const;
+
 	// Возвращает true если точка лежит внутри объекта
 	bool isContainPoint(const QPointF &pt) const;
 
@@ -85,17 +103,26 @@ public:
 	// Загружает объект из бинарного потока
 	virtual bool load(QDataStream &stream);
 
+	// Загружает ресурсы объекта (текстуры, шрифты); должна вызываться в главном потоке
+	virtual void loadResources() = 0;
+
 	// Сохраняет объект в бинарный поток
 	virtual bool save(QDataStream &stream);
 
 	// Загружает объект из Lua скрипта
 	virtual bool load(LuaScript &script);
 
+	// Регистрирует в Lua скрипте ключи свойств игровых объектов для загрузки объектов за один обход таблицы
+	static void registerPropertyKeys(LuaScript &script);
+
 	// Сохраняет объект в текстовый поток
 	virtual bool save(QTextStream &stream, int indent);
 
 	// Устанавливает текущий язык для объекта
-	virtual void setCurrentLanguage(const QString &language);
+	virtual void setCurrentLanguage(int language);
+
+	// Переключает объект на текущий язык проекта, если язык сменился с момента последнего переключения; возвращает true, если объект изменился
+	bool updateCurrentLanguage();
 
 	// Определяет, локализован ли объект для текущего языка
 	virtual bool isLocalized() const;
@@ -116,13 +143,25 @@ public:
 	virtual bool changeTexture(const QString &fileName, const QSharedPointer<Texture> &texture) = 0;
 
 	// Отрисовывает объект
-	virtual void draw() = 0;
+	virtual void draw(SpriteBatch &batch) = 0;
 
 protected:
 
 	// Типы для локализованных данных
-	typedef QMap<QString, qreal> RealMap;
-	typedef QMap<QString, QString> StringMap;
+	typedef LocalizedArray<qreal> RealMap;
+	typedef LocalizedArray<QString> StringMap;
+
+	// Индексы ключей свойств игровых объектов в таблицах Lua
+	enum PropertyKey
+	{
+		KEY_NAME, KEY_ID, KEY_POS_X, KEY_POS_Y, KEY_WIDTH, KEY_HEIGHT, KEY_ANGLE, KEY_CENTER_X, KEY_CENTER_Y,
+		KEY_FILE_NAME, KEY_TEXTURE_WIDTH, KEY_TEXTURE_HEIGHT, KEY_COLOR,
+		KEY_TEXT, KEY_SIZE, KEY_HORZ_ALIGNMENT, KEY_VERT_ALIGNMENT, KEY_LINE_SPACING,
+		NUM_PROPERTY_KEYS
+	};
+
+	// Количество обязательных свойств игрового объекта
+	static const int NUM_PROPERTIES = 9;
 
 	// Конвертирует координаты из локальных в мировые
 	QPointF localToWorld(const QPointF &pt) const;
@@ -133,14 +172,20 @@ protected:
 	// Обновляет текущую трансформацию объекта
 	void updateTransform();
 
-	// Читает список локализованных вещественных чисел
-	bool readRealMap(LuaScript &script, const QString &name, RealMap &map);
+	// Загружает свойства объекта за один обход текущей таблицы Lua скрипта и проверяет количество загруженных свойств
+	bool loadProperties(LuaScript &script, int numProperties);
+
+	// Загружает свойство объекта по индексу ключа из значения на вершине стека, увеличивая счетчик загруженных свойств
+	virtual bool loadProperty(LuaScript &script, int key, int &numProperties);
+
+	// Читает список локализованных вещественных чисел из значения на вершине стека
+	bool readRealMap(LuaScript &script, RealMap &map);
 
 	// Записывает список локализованных вещественных чисел
 	void writeRealMap(QTextStream &stream, const RealMap &map);
 
-	// Читает список локализованных строк
-	bool readStringMap(LuaScript &script, const QString &name, StringMap &map);
+	// Читает список локализованных строк из значения на вершине стека
+	bool readStringMap(LuaScript &script, StringMap &map);
 
 	// Записывает список локализованных строк
 	void writeStringMap(QTextStream &stream, const StringMap &map);
@@ -152,6 +197,9 @@ protected:
 	qreal       mRotationAngle;     // Угол поворота объекта в градусах по часовой стрелке
 	QPointF     mRotationCenter;    // Центр вращения в нормализованных локальных координатах
 	Layer       *mParentLayer;      // Указатель на родительский слой
+	quint32     mUndoKey;           // Ключ объекта в истории отмен
+	bool        mUndoDirty;         // Флаг изменения объекта с момента последней записи в историю отмен
+	int         mLanguageVersion;   // Версия языка, для которого установлены текущие значения локализованных свойств
 
 	RealMap     mPositionXMap;      // Список локализованных координат по оси X
 	RealMap     mPositionYMap;      // Список локализованных координат по оси Y
@@ -15,6 +15,9 @@ public:
 
 	// Устанавливает текущий стек отмен
 	void setUndoStack(QUndoStack *undoStack);
+
+	// Отображает объем памяти, занимаемый текущей историей отмен
+	void setUndoMemoryUsage(qint64 bytes);
 };
 
 #endif // HISTORY_WINDOW_H
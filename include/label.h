@@ -79,6 +79,9 @@ public:
 	// Загружает объект из бинарного потока
 	virtual bool load(QDataStream &stream);
 
+	// Загружает локализованные шрифты
+	virtual void loadResources();
+
 	// Сохраняет объект в бинарный поток
 	virtual bool save(QDataStream &stream);
 
@@ -89,7 +92,7 @@ public:
 	virtual bool save(QTextStream &stream, int indent);
 
 	// Устанавливает текущий язык для объекта
-	virtual void setCurrentLanguage(const QString &language);
+	virtual void setCurrentLanguage(int language);
 
 	// Определяет, локализован ли объект для текущего языка
 	virtual bool isLocalized() const;
@@ -109,16 +112,30 @@ public:
 	// Заменяет текстуру в объекте
 	virtual bool changeTexture(const QString &fileName, const QSharedPointer<Texture> &texture);
 
+	// Возвращает прямоугольник, охватывающий надпись и выходящий за ее пределы текст
+	virtual QRectF getDrawingRect() const;
+
 	// Отрисовывает объект
-	virtual void draw();
+	virtual void draw(SpriteBatch &batch);
+
+protected:
+
+	// Загружает свойство надписи по индексу ключа из значения на вершине стека, увеличивая счетчик загруженных свойств
+	virtual bool loadProperty(LuaScript &script, int key, int &numProperties);
 
 private:
 
-	// Тип для списка локализованных шрифтов
-	typedef QMap<QString, QSharedPointer<Font> > FontMap;
+	// Сбрасывает разбивку текста на строки и ограничивающий прямоугольник родительского слоя
+	void invalidateLayout();
 
-	// Загружает локализованные шрифты
-	void loadFonts();
+	// Пересчитывает разбивку текста на строки, если она устарела или изменились размеры надписи
+	void updateLayout() const;
+
+	// Количество обязательных свойств надписи
+	static const int NUM_PROPERTIES = GameObject::NUM_PROPERTIES + 7;
+
+	// Тип для списка локализованных шрифтов
+	typedef LocalizedArray<QSharedPointer<Font> > FontMap;
 
 	QString                 mText;              // Текст надписи
 	QString                 mFileName;          // Имя файла со шрифтом
@@ -134,6 +151,13 @@ private:
 	FontMap                 mFontMap;           // Список локализованных шрифтов
 
 	StringMap               mTranslationMap;    // Таблица переводов для надписи
+
+	mutable bool                    mLayoutValid;   // Флаг актуальности кэша разбивки текста на строки
+	mutable QSizeF                  mLayoutSize;    // Размеры надписи, для которых рассчитана разбивка
+	mutable QVector<std::wstring>   mLayoutLines;   // Строки текста после переноса слов
+	mutable QVector<qreal>          mLayoutWidths;  // Ширины строк в пикселях
+	mutable QVector<QPointF>        mLayoutOffsets; // Смещения строк с учетом выравнивания
+	mutable QRectF                  mLayoutRect;    // Прямоугольник надписи и ее строк в локальных координатах
 };
 
 #endif // LABEL_H
@@ -2,6 +2,7 @@
 #define LAYER_H
 
 #include "base_layer.h"
+#include "spatial_index.h"
 
 // Класс обычного слоя
 class Layer : public BaseLayer
@@ -21,7 +22,7 @@ public:
 	virtual ~Layer();
 
 	// Возвращает количество игровых объектов в слое
-	int getNumGameObjects() const;
+	virtual int getNumGameObjects() const;
 
 	// Возвращает индекс игрового объекта в списке
 	int indexOfGameObject(GameObject *object) const;
@@ -35,6 +36,12 @@ public:
 	// Удаляет игровой объект
 	void removeGameObject(int index);
 
+	// Обновляет положение игрового объекта в пространственном индексе
+	void updateSpatialIndex(GameObject *object);
+
+	// Обновляет имя игрового объекта в индексе имен после его изменения
+	void updateNameIndex(GameObject *object, const QString &oldName);
+
 	// Загружает слой из бинарного потока
 	virtual bool load(QDataStream &stream);
 
@@ -56,8 +63,8 @@ public:
 	// Ищет все активные игровые объекты
 	virtual QList<GameObject *> findActiveGameObjects() const;
 
-	// Рекурсивно ищет игровой объект по заданному имени
-	virtual GameObject *findGameObjectByName(const QString &name) const;
+	// Ищет все видимые игровые объекты
+	virtual QList<GameObject *> findVisibleGameObjects() const;
 
 	// Ищет игровой объект, содержащий заданную точку
 	virtual GameObject *findGameObjectByPoint(const QPointF &pt) const;
@@ -74,8 +81,8 @@ public:
 	// Привязывает координату по оси Y к игровым объектам
 	virtual void snapYCoord(qreal y, qreal x1, qreal x2, const QList<GameObject *> &excludedObjects, qreal &snappedY, qreal &distance, QLineF &line) const;
 
-	// Устанавливает текущий язык для слоя
-	virtual void setCurrentLanguage(const QString &language);
+	// Переключает на текущий язык объекты слоя, язык которых устарел; возвращает true, если объекты изменились
+	virtual bool updateCurrentLanguage();
 
 	// Загружает переводы из Lua скрипта
 	virtual void loadTranslations(LuaScript *script);
@@ -89,13 +96,18 @@ public:
 	// Заменяет текстуру в слое
 	virtual QList<GameObject *> changeTexture(const QString &fileName, const QSharedPointer<Texture> &texture);
 
-	// Отрисовывает слой
-	virtual void draw(bool ignoreVisibleState = false);
+	// Отрисовывает часть слоя, попадающую в видимую область
+	virtual void draw(SpriteBatch &batch, const QRectF &visibleRect, bool ignoreVisibleState = false);
 
 private:
 
-	// Список игровых объектов
-	QList<GameObject *> mGameObjects;
+	// Возвращает индексы игровых объектов в списке, пересчитывая их при необходимости
+	const QHash<GameObject *, int> &getGameObjectIndices() const;
+
+	QList<GameObject *>                 mGameObjects;               // Список игровых объектов
+	SpatialIndex                        mSpatialIndex;              // Пространственный индекс игровых объектов
+	mutable QHash<GameObject *, int>    mGameObjectIndices;         // Индексы игровых объектов в списке
+	mutable bool                        mGameObjectIndicesValid;    // Флаг актуальности индексов игровых объектов
 };
 
 #endif // LAYER_H
@@ -32,11 +32,14 @@ public:
 	// Возвращает список всех игровых объектов
 	virtual QList<GameObject *> getGameObjects() const;
 
+	// Возвращает количество всех игровых объектов
+	virtual int getNumGameObjects() const;
+
 	// Ищет все активные игровые объекты
 	virtual QList<GameObject *> findActiveGameObjects() const;
 
-	// Рекурсивно ищет игровой объект по заданному имени
-	virtual GameObject *findGameObjectByName(const QString &name) const;
+	// Ищет все видимые игровые объекты
+	virtual QList<GameObject *> findVisibleGameObjects() const;
 
 	// Ищет игровой объект, содержащий заданную точку
 	virtual GameObject *findGameObjectByPoint(const QPointF &pt) const;
@@ -53,8 +56,8 @@ public:
 	// Привязывает координату по оси Y к игровым объектам
 	virtual void snapYCoord(qreal y, qreal x1, qreal x2, const QList<GameObject *> &excludedObjects, qreal &snappedY, qreal &distance, QLineF &line) const;
 
-	// Устанавливает текущий язык для слоя
-	virtual void setCurrentLanguage(const QString &language);
+	// Переключает на текущий язык объекты слоя, язык которых устарел; возвращает true, если объекты изменились
+	virtual bool updateCurrentLanguage();
 
 	// Загружает переводы из Lua скрипта
 	virtual void loadTranslations(LuaScript *script);
@@ -68,8 +71,8 @@ public:
 	// Заменяет текстуру в слое
 	virtual QList<GameObject *> changeTexture(const QString &fileName, const QSharedPointer<Texture> &texture);
 
-	// Отрисовывает слой
-	virtual void draw(bool ignoreVisibleState = false);
+	// Отрисовывает часть слоя, попадающую в видимую область
+	virtual void draw(SpriteBatch &batch, const QRectF &visibleRect, bool ignoreVisibleState = false);
 };
 
 #endif // LAYER_GROUP_H
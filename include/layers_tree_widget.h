@@ -2,6 +2,7 @@
 #define LAYERS_TREE_WIDGET_H
 
 #include "base_layer.h"
+#include "sprite_batch.h"
 
 class Scene;
 
@@ -179,6 +180,7 @@ private:
 
 	QGLWidget             *mPrimaryGLWidget;      // указатель на OpenGL виджет
 	QGLFramebufferObject  *mFrameBuffer;          // фреймбуфер для отрисовки иконки предпросмотра спрайта
+	SpriteBatch           mSpriteBatch;          // пакет для отрисовки спрайтов в иконке предпросмотра
 
 	QMenu                 *mContextMenu;          // контекстное меню
 	QAction               *mDuplicateAction;      // - пункт меню "Дублировать"
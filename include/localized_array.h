@@ -0,0 +1,167 @@
+#ifndef LOCALIZED_ARRAY_H
+#define LOCALIZED_ARRAY_H
+
+#include "project.h"
+
+// Шаблон компактного списка локализованных значений, индексируемого идентификаторами языков:
+// значения первых MAX_LANGUAGES языков хранятся подряд в порядке идентификаторов, а наличие значений - в битовой маске;
+// значения языков с большими идентификаторами хранятся в отдельном словаре
+template<typename T>
+class LocalizedArray
+{
+public:
+
+	// Конструктор
+	LocalizedArray()
+	: mMask(0)
+	{
+	}
+
+	// Проверяет, задано ли значение для языка
+	bool contains(int language) const
+	{
+		if (language >= Project::MAX_LANGUAGES)
+			return mExtraValues.contains(language);
+		return language >= 0 && (mMask & (1u << language)) != 0;
+	}
+
+	// Возвращает значение для языка или значение по умолчанию, если оно не задано
+	T value(int language) const
+	{
+		if (language >= Project::MAX_LANGUAGES)
+			return mExtraValues.value(language);
+		return contains(language) ? mValues[getPosition(language)] : T();
+	}
+
+	// Возвращает значение для языка или значение по умолчанию, если оно не задано
+	T operator[](int language) const
+	{
+		return value(language);
+	}
+
+	// Возвращает ссылку на значение для языка, добавляя значение по умолчанию, если оно не задано
+	T &operator[](int language)
+	{
+		if (language >= Project::MAX_LANGUAGES)
+			return mExtraValues[language];
+		if (!contains(language))
+			insert(language, T());
+		return mValues[getPosition(language)];
+	}
+
+	// Устанавливает значение для языка
+	void insert(int language, const T &value)
+	{
+		Q_ASSERT(language >= 0);
+		if (language >= Project::MAX_LANGUAGES)
+		{
+			mExtraValues.insert(language, value);
+		}
+		else if (contains(language))
+		{
+			mValues[getPosition(language)] = value;
+		}
+		else
+		{
+			mValues.insert(getPosition(language), value);
+			mMask |= 1u << language;
+		}
+	}
+
+	// Удаляет значение для языка
+	void remove(int language)
+	{
+		if (language >= Project::MAX_LANGUAGES)
+		{
+			mExtraValues.remove(language);
+		}
+		else if (contains(language))
+		{
+			mValues.remove(getPosition(language));
+			mMask &= ~(1u << language);
+		}
+	}
+
+	// Удаляет все значения
+	void clear()
+	{
+		mValues.clear();
+		mExtraValues.clear();
+		mMask = 0;
+	}
+
+	// Проверяет, что не задано ни одного значения
+	bool isEmpty() const
+	{
+		return mMask == 0 && mExtraValues.isEmpty();
+	}
+
+	// Возвращает количество заданных значений
+	int size() const
+	{
+		return mValues.size() + mExtraValues.size();
+	}
+
+	// Возвращает идентификатор следующего языка с заданным значением после указанного (-1, если таких нет)
+	int nextLanguage(int language = -1) const
+	{
+		for (int i = language + 1; i < Project::MAX_LANGUAGES; ++i)
+			if ((mMask & (1u << i)) != 0)
+				return i;
+		typename QMap<int, T>::const_iterator it = mExtraValues.upperBound(language);
+		return it != mExtraValues.end() ? it.key() : -1;
+	}
+
+	// Возвращает идентификаторы языков с заданными значениями, упорядоченные по кодам языков
+	QMap<QString, int> getLanguagesByCode() const
+	{
+		QMap<QString, int> languages;
+		for (int language = nextLanguage(); language != -1; language = nextLanguage(language))
+			languages.insert(Project::getSingleton().getLanguageCode(language), language);
+		return languages;
+	}
+
+private:
+
+	// Возвращает позицию значения языка в массиве - количество заданных языков с меньшими идентификаторами
+	int getPosition(int language) const
+	{
+		quint32 mask = mMask & ((1u << language) - 1);
+		mask = mask - ((mask >> 1) & 0x55555555);
+		mask = (mask & 0x33333333) + ((mask >> 2) & 0x33333333);
+		return static_cast<int>((((mask + (mask >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+	}
+
+	quint32         mMask;          // Битовая маска языков с заданными значениями
+	QVector<T>      mValues;        // Значения заданных языков в порядке возрастания идентификаторов
+	QMap<int, T>    mExtraValues;   // Значения языков с идентификаторами, не помещающимися в битовую маску
+};
+
+// Сохраняет список локализованных значений в бинарный поток с кодами языков, не зависящими от порядка их регистрации
+template<typename T>
+QDataStream &operator<<(QDataStream &stream, const LocalizedArray<T> &array)
+{
+	stream << static_cast<quint32>(array.size());
+	for (int language = array.nextLanguage(); language != -1; language = array.nextLanguage(language))
+		stream << Project::getSingleton().getLanguageCode(language) << array.value(language);
+	return stream;
+}
+
+// Загружает список локализованных значений из бинарного потока
+template<typename T>
+QDataStream &operator>>(QDataStream &stream, LocalizedArray<T> &array)
+{
+	array.clear();
+	quint32 size;
+	stream >> size;
+	for (quint32 i = 0; i < size && stream.status() == QDataStream::Ok; ++i)
+	{
+		QString code;
+		T value;
+		stream >> code >> value;
+		array.insert(Project::getSingleton().getLanguageId(code), value);
+	}
+	return stream;
+}
+
+#endif // LOCALIZED_ARRAY_H
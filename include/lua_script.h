@@ -81,10 +81,20 @@ public:
 	// Извлекает таблицу из стека
 	void popTable();
 
+	// Извлекает значение с вершины стека
+	void popValue();
+
+	// Регистрирует строки ключей таблиц для быстрого сравнения с ключами элементов при обходе таблиц
+	void registerKeys(const char *const *names, int count);
+
+	// Возвращает индекс зарегистрированного строкового ключа текущего элемента таблицы или -1
+	int getEntryKey() const;
+
 private:
 
-	lua_State   *mLuaState;     // Состояние Lua
-	int         mTableIndex;    // Индекс текущей таблицы в стеке
+	lua_State                   *mLuaState;     // Состояние Lua
+	int                         mTableIndex;    // Индекс текущей таблицы в стеке
+	QHash<const char *, int>    mKeys;          // Индексы зарегистрированных ключей по адресам интернированных строк Lua
 };
 
 #endif // LUA_SCRIPT_H
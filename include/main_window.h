@@ -2,6 +2,7 @@
 #define MAIN_WINDOW_H
 
 #include "ui_main_window.h"
+#include "texture_manager.h"
 
 class EditorWindow;
 class FontBrowser;
@@ -33,9 +34,6 @@ public:
 
 protected:
 
-	// Вызывается при получении события
-	virtual bool event(QEvent *event);
-
 	// Вызывается по срабатыванию таймера
 	virtual void timerEvent(QTimerEvent *event);
 
@@ -158,12 +156,24 @@ private slots:
 	// Обработчик изменения разрешенных операций редактирования в окне свойств
 	void onPropertyWindowAllowedEditorActionsChanged();
 
-	// Обработчик сигнала изменения текстуры от текстурного менеджера
-	void onTextureChanged(const QString &fileName, const QSharedPointer<Texture> &texture);
+	// Обработчик сигнала изменения текстур от текстурного менеджера
+	void onTexturesChanged(const TextureManager::TextureMap &textures);
 
 	// Обработчик изменения содержимого буфера обмена
 	void onClipboardDataChanged();
 
+	// Обработчик завершения разбора файла сцены в рабочем потоке
+	void onSceneParsed();
+
+	// Обработчик таймера автосохранения
+	void onAutosaveTimeout();
+
+	// Обработчик завершения автосохранения сцены в рабочем потоке
+	void onSceneAutosaved();
+
+	// Предлагает восстановить сцены из файлов восстановления, оставшихся после аварийного завершения
+	void restoreRecoveryFiles();
+
 private:
 
 	// Структура с информацией о файле переводов
@@ -203,6 +213,33 @@ private:
 		MainWindow *mParent;
 	};
 
+	// Открывает файл сцены, запуская его разбор в рабочем потоке
+	void openFile(const QString &fileName);
+
+	// Запускает разбор файла сцены в рабочем потоке
+	void parseFile(const QString &fileName);
+
+	// Дожидается завершения разбора сцен и автосохранения в рабочих потоках, отбрасывая результаты разбора
+	void waitForWorkers();
+
+	// Показывает одним сообщением ошибки открытия сцен, накопившиеся к завершению их разбора
+	void reportParseErrors();
+
+	// Генерирует имя файла для новой безымянной сцены
+	QString generateUntitledFileName();
+
+	// Перезапускает таймер автосохранения с интервалом из настроек
+	void updateAutosaveTimer();
+
+	// Возвращает каталог для файлов восстановления
+	QString getRecoveryDirectory() const;
+
+	// Удаляет файл восстановления окна редактирования, дожидаясь завершения его записи
+	void removeRecoveryFile(EditorWindow *editorWindow);
+
+	// Сохраняет в настройках список файлов восстановления открытых сцен
+	void saveRecoveryList();
+
 	// Создает новое окно редактирования
 	EditorWindow *createEditorWindow(const QString &fileName);
 
@@ -221,18 +258,19 @@ private:
 	// Проверяет текущую сцену на наличие отсутствующих файлов
 	void checkMissedFiles();
 
+	// Перерисовывает окно редактирования текущей вкладки
+	void updateCurrentEditorWindow();
+
 	SpriteBrowser       *mSpriteBrowser;            // Браузер спрайтов
 	FontBrowser         *mFontBrowser;              // Браузер шрифтов
 	PropertyWindow      *mPropertyWindow;           // Окно свойств объекта
 	LayersWindow        *mLayersWindow;             // Окно слоев
 	HistoryWindow       *mHistoryWindow;            // Окно истории
 
-	bool                mRenderEnabled;             // Флаг разрешения отрисовки по таймеру
 	int                 mUntitledIndex;             // Текущий номер для новых файлов
 	int                 mTabWidgetCurrentIndex;     // Текущий индекс вкладки
 
 	QGLWidget           *mPrimaryGLWidget;          // OpenGL виджет для загрузки текстур в главном потоке
-	QGLWidget           *mSecondaryGLWidget;        // OpenGL виджет для загрузки текстур в фоновом потоке
 	QLabel              *mMousePosLabel;            // Текстовое поле для координат мыши в строке статуса
 	QComboBox           *mZoomComboBox;             // Выпадающий список масштабов
 	QList<qreal>        mZoomList;                  // Список масштабов
@@ -241,7 +279,16 @@ private:
 
 	QFileSystemWatcher  *mTranslationFilesWatcher;  // Объект слежения за файлами переводов
 	TranslationFilesMap mTranslationFilesMap;       // Список файлов переводов, поставленных на слежение
-	int                 mTranslationCounter;        // Счетчик для перезагрузки файлов переводов по таймеру
+
+	QMap<QString, QFutureWatcher<QByteArray> *> mParsingFiles;          // Файлы сцен, разбираемые в рабочих потоках
+	QStringList                                 mParseErrors;           // Ошибки открытия сцен, еще не показанные пользователю
+	bool                                        mReportingParseErrors;  // Флаг показа сообщения об ошибках открытия сцен
+
+	QTimer                                          *mAutosaveTimer;    // Таймер автосохранения копий измененных сцен
+	int                                             mRecoveryIndex;     // Текущий номер для имен файлов восстановления
+	QMap<EditorWindow *, QString>                   mRecoveryFiles;     // Файлы восстановления окон редактирования
+	QMap<EditorWindow *, QFutureWatcher<bool> *>    mAutosavingScenes;  // Сцены, сохраняемые в файлы восстановления в рабочих потоках
+	QMap<QString, QString>                          mRecoveringFiles;   // Имена файлов сцен по именам разбираемых файлов восстановления
 };
 
 #endif // MAIN_WINDOW_H
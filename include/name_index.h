@@ -0,0 +1,56 @@
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+class GameObject;
+
+// Класс индекса имен игровых объектов с учетом номеров копий для генерации имен копий
+class NameIndex
+{
+public:
+
+	// Конструктор
+	NameIndex();
+
+	// Добавляет игровой объект с заданным именем в индекс
+	void insert(const QString &name, GameObject *object);
+
+	// Удаляет игровой объект с заданным именем из индекса
+	void remove(const QString &name, GameObject *object);
+
+	// Переносит в индекс все записи другого индекса, очищая его
+	void takeFrom(NameIndex &index);
+
+	// Возвращает все игровые объекты с заданным именем
+	QList<GameObject *> findAll(const QString &name) const;
+
+	// Возвращает наименьший номер копии не меньше заданного, не занятый именами с заданной базовой частью
+	int findFreeCopyIndex(const QString &baseName, int index) const;
+
+	// Выделяет из имени базовую часть и номер копии (0 - не копия, 1 - "копия", N - "копия N")
+	static void splitName(const QString &name, QString &baseName, int &index);
+
+	// Составляет имя копии из базовой части и номера копии
+	static QString joinName(const QString &baseName, int index);
+
+private:
+
+	// Занятые номера копий для базовой части имени
+	struct CopyIndices
+	{
+		QMap<int, int>  mCounts;    // Количество имен по номерам копий
+		QMap<int, int>  mRanges;    // Непрерывные диапазоны занятых номеров: первый номер -> последний номер
+	};
+
+	// Учитывает имя с заданным номером копии
+	void addCopyIndex(const QString &baseName, int index);
+
+	// Перестает учитывать имя с заданным номером копии
+	void removeCopyIndex(const QString &baseName, int index);
+
+	static const QString COPY_SUFFIX;   // Суффикс имени копии
+
+	QMultiHash<QString, GameObject *>   mObjects;       // Игровые объекты по именам
+	QHash<QString, CopyIndices>         mCopyIndices;   // Занятые номера копий для каждой базовой части имени
+};
+
+#endif // NAME_INDEX_H
@@ -82,6 +82,36 @@ public:
 	// Устанавливает флаг разрешения умных направляющих
 	void setEnableSmartGuides(bool enableSmartGuides);
 
+	// Возвращает максимальную частоту перерисовки окна редактора при перетаскивании
+	int getMaxDragFrameRate() const;
+
+	// Устанавливает максимальную частоту перерисовки окна редактора при перетаскивании
+	void setMaxDragFrameRate(int maxDragFrameRate);
+
+	// Возвращает ограничение памяти для истории отмен каждой вкладки в мегабайтах
+	int getUndoMemoryLimit() const;
+
+	// Устанавливает ограничение памяти для истории отмен каждой вкладки в мегабайтах
+	void setUndoMemoryLimit(int undoMemoryLimit);
+
+	// Возвращает интервал автосохранения копий сцен для восстановления в минутах
+	int getAutosaveInterval() const;
+
+	// Устанавливает интервал автосохранения копий сцен для восстановления в минутах
+	void setAutosaveInterval(int autosaveInterval);
+
+	// Возвращает количество неиспользуемых шрифтов, удерживаемых в кэше
+	int getFontCacheSize() const;
+
+	// Устанавливает количество неиспользуемых шрифтов, удерживаемых в кэше
+	void setFontCacheSize(int fontCacheSize);
+
+	// Возвращает время хранения неиспользуемых шрифтов в кэше в секундах
+	int getFontCacheTimeout() const;
+
+	// Устанавливает время хранения неиспользуемых шрифтов в кэше в секундах
+	void setFontCacheTimeout(int fontCacheTimeout);
+
 private:
 
 	QString     mLastOpenedDirectory;   // Последний открытый каталог
@@ -97,6 +127,12 @@ private:
 	bool        mShowGuides;            // Флаг показа направляющих
 	bool        mSnapToGuides;          // Флаг привязки к направляющим
 	bool        mEnableSmartGuides;     // Флаг разрешения умных направляющих
+
+	int         mMaxDragFrameRate;      // Максимальная частота перерисовки при перетаскивании (0 - без ограничения)
+	int         mUndoMemoryLimit;       // Ограничение памяти для истории отмен в мегабайтах (0 - без ограничения)
+	int         mAutosaveInterval;      // Интервал автосохранения в минутах (0 - автосохранение отключено)
+	int         mFontCacheSize;         // Количество неиспользуемых шрифтов в кэше (0 - шрифты удаляются сразу)
+	int         mFontCacheTimeout;      // Время хранения неиспользуемых шрифтов в секундах (0 - без ограничения)
 };
 
 #endif // OPTIONS_H
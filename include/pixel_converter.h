@@ -0,0 +1,19 @@
+#ifndef PIXEL_CONVERTER_H
+#define PIXEL_CONVERTER_H
+
+// Класс для преобразования пикселей изображений Qt в формат текстур OpenGL
+class PixelConverter
+{
+public:
+
+	// Преобразует пиксели формата QImage::Format_ARGB32 или QImage::Format_RGB32 в байты RGBA, при необходимости умножая цвета на альфу;
+	// исходный и результирующий буферы могут совпадать
+	static void convertToRGBA(const quint32 *src, quint32 *dst, int count, bool opaque, bool premultiply);
+
+private:
+
+	// Преобразует пиксели без использования SIMD-инструкций
+	static void convertScalar(const quint32 *src, quint32 *dst, int count, bool opaque, bool premultiply);
+};
+
+#endif // PIXEL_CONVERTER_H
@@ -10,6 +10,9 @@ class Project : public Singleton<Project>
 
 public:
 
+	// Количество языков, значения которых хранятся в битовой маске списков локализации; остальные хранятся отдельно
+	static const int MAX_LANGUAGES = 32;
+
 	// Конструктор
 	Project();
 
@@ -58,6 +61,21 @@ public:
 	// Устанавливает код текущего выбранного языка
 	void setCurrentLanguage(const QString &language);
 
+	// Возвращает идентификатор языка по коду, регистрируя новые коды; может вызываться из рабочего потока
+	int getLanguageId(const QString &language);
+
+	// Возвращает код языка по идентификатору
+	QString getLanguageCode(int id) const;
+
+	// Возвращает идентификатор языка по умолчанию
+	int getDefaultLanguageId() const;
+
+	// Возвращает идентификатор текущего выбранного языка
+	int getCurrentLanguageId() const;
+
+	// Возвращает версию текущего языка, увеличивающуюся при каждой его смене
+	int getLanguageVersion() const;
+
 private:
 
 	// Загружает файл проекта
@@ -66,6 +84,9 @@ private:
 	// Сохраняет файл проекта
 	bool saveProjectFile(const QString &fileName);
 
+	// Заполняет таблицу идентификаторов языками проекта
+	void registerLanguages();
+
 	QString     mFileName;              // Имя файла проекта
 	QString     mRootDirectory;         // Абсолютный путь к корневому каталогу проекта
 	QString     mScenesDirectory;       // Относительный путь к каталогу со сценами
@@ -78,6 +99,13 @@ private:
 	QStringList mLanguageNames;         // Список названий доступных языков
 	QString     mDefaultLanguage;       // Код языка по умолчанию
 	QString     mCurrentLanguage;       // Код текущего выбранного языка
+
+	QStringList             mLanguageCodes;     // Коды языков по идентификаторам: языки проекта, затем встреченные в файлах
+	QHash<QString, int>     mLanguageIds;       // Идентификаторы языков по кодам
+	mutable QReadWriteLock  mLanguageIdsLock;   // Блокировка таблицы идентификаторов языков для рабочих потоков
+	int                     mDefaultLanguageId; // Идентификатор языка по умолчанию
+	int                     mCurrentLanguageId; // Идентификатор текущего выбранного языка
+	int                     mLanguageVersion;   // Версия текущего языка для отложенного переключения объектов
 };
 
 #endif // PROJECT_H
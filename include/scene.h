@@ -18,15 +18,33 @@ public:
 	// Деструктор
 	virtual ~Scene();
 
-	// Загружает сцену из файла
-	bool load(const QString &fileName);
+	// Разбирает файл сцены в бинарное представление, используя кэш или Lua скрипт; может вызываться из рабочего потока
+	static QByteArray parse(const QString &fileName);
+
+	// Загружает сцену из бинарного представления, созданного функцией parse
+	bool load(const QByteArray &data);
+
+	// Удаляет бинарный кэш файла сцены, чтобы следующий разбор выполнил Lua скрипт; возвращает false, если кэша не было
+	static bool removeCache(const QString &fileName);
 
 	// Сохраняет сцену в файл
 	bool save(const QString &fileName);
 
+	// Снимок состояния сцены для сохранения в рабочем потоке
+	struct Snapshot;
+
+	// Создает снимок текущего состояния сцены, разделяющий данные с историей отмен
+	Snapshot createSnapshot() const;
+
+	// Сохраняет снимок состояния сцены в Lua файл; может вызываться из рабочего потока
+	static bool saveSnapshot(const Snapshot &snapshot, const QString &fileName);
+
 	// Загружает файл переводов
 	bool loadTranslationFile(const QString &fileName);
 
+	// Загружает переводы из файла только для заданных объектов
+	bool loadTranslationFile(const QString &fileName, const QList<GameObject *> &objects);
+
 	// Ищет объекты, используемые в файле имен
 	QList<GameObject *> findUsedGameObjects(const QString &fileName, const QList<GameObject *> &objects) const;
 
@@ -66,6 +84,18 @@ public:
 	// Повторяет текущую команду
 	void redo();
 
+	// Возвращает объем памяти, занимаемый историей отмен, в байтах
+	qint64 getUndoMemoryUsage() const;
+
+	// Возвращает игровые объекты, созданные или перезагруженные при последней отмене/повторе команды
+	QList<GameObject *> getRestoredGameObjects() const;
+
+	// Возвращает слои, список или свойства объектов которых изменились при последней отмене/повторе команды
+	QList<BaseLayer *> getRestoredLayers() const;
+
+	// Проверяет, изменились ли свойства и структура слоев или активный слой при последней отмене/повторе команды
+	bool isLayerTreeRestored() const;
+
 	// Создает новый слой
 	BaseLayer *createLayer(BaseLayer *parent = NULL, int index = 0);
 
@@ -117,7 +147,41 @@ private slots:
 
 private:
 
-	// Класс команды отмены
+	// Начальный размер буфера для сохранения сцены и его прирост на каждый игровой объект в символах
+	static const int SAVE_BUFFER_BASE_SIZE = 4096;
+	static const int SAVE_BUFFER_OBJECT_SIZE = 320;
+
+	// Сигнатура и версия формата бинарного кэша сцены
+	static const quint32 CACHE_MAGIC = 0x47435343;
+	static const quint32 CACHE_VERSION = 3;
+
+	// Количество команд между контрольными точками с полным состоянием сцены
+	static const int CHECKPOINT_INTERVAL = 100;
+
+	// Доля ограничения памяти, до которой сокращается история отмен при его превышении, в процентах
+	static const int UNDO_TRIM_PERCENT = 75;
+
+	// Размер сериализованных данных записи, начиная с которого они сжимаются
+	static const int COMPRESSION_THRESHOLD = 128;
+
+	// Оценка служебных расходов памяти на одну запись в списке записей
+	static const int RECORD_OVERHEAD = 32;
+
+	// Запись состояния слоя или игрового объекта в истории отмен
+	struct UndoRecord
+	{
+		// Конструктор
+		UndoRecord();
+
+		QByteArray      mData;          // Сериализованные свойства слоя или объекта, пустые для отсутствующей записи
+		bool            mCompressed;    // Флаг сжатия сериализованных данных
+		QList<quint32>  mChildren;      // Ключи дочерних слоев или игровых объектов слоя
+	};
+
+	// Тип для списка записей состояния по ключам
+	typedef QHash<quint32, UndoRecord> UndoRecordMap;
+
+	// Класс команды отмены, хранящей изменения только затронутых слоев и объектов
 	class UndoCommand : public QUndoCommand
 	{
 	public:
@@ -125,20 +189,125 @@ private:
 		// Конструктор
 		UndoCommand(const QString &text, Scene *scene);
 
-		// Восстанавливает ранее сохраненное состояние сцены
-		void restore();
+		// Конструктор контрольной точки с заданным состоянием сцены
+		UndoCommand(const UndoRecordMap &records, const QByteArray &header);
+
+		// Конструктор копирования
+		UndoCommand(const UndoCommand &command);
+
+		// Возвращает объем памяти, занимаемый командой, в байтах
+		qint64 getMemoryUsage() const;
+
+		// Проверяет, хранит ли команда контрольную точку с полным состоянием сцены
+		bool isCheckpoint() const;
+
+		// Заменяет записи состояния сцены контрольной точкой команды, запоминая ключи отличающихся записей
+		void restoreCheckpoint(UndoRecordMap &records, QByteArray &header, QSet<quint32> &changedKeys) const;
+
+		// Откатывает изменения команды в записях состояния сцены, запоминая ключи измененных записей
+		void revert(UndoRecordMap &records, QByteArray &header, QSet<quint32> &changedKeys) const;
+
+		// Применяет изменения команды к записям состояния сцены, запоминая ключи измененных записей
+		void apply(UndoRecordMap &records, QByteArray &header, QSet<quint32> &changedKeys) const;
 
 	private:
 
-		Scene       *mScene;        // Указатель на объект сцены
-		QByteArray  mData;          // Сохраненное состояние сцены
+		// Переносит записи из списка изменений в записи состояния сцены
+		static void applyRecords(const UndoRecordMap &changes, UndoRecordMap &records, QSet<quint32> &changedKeys);
+
+		// Вычисляет объем памяти, занимаемый командой
+		void updateMemoryUsage(bool initialState);
+
+		UndoRecordMap   mOldRecords;        // Записи затронутых элементов до выполнения команды
+		UndoRecordMap   mNewRecords;        // Записи затронутых элементов после выполнения команды
+		QByteArray      mOldHeader;         // Общие свойства сцены до выполнения команды
+		QByteArray      mNewHeader;         // Общие свойства сцены после выполнения команды
+		bool            mCheckpoint;        // Флаг контрольной точки
+		UndoRecordMap   mCheckpointRecords; // Полное состояние слоев и объектов в контрольной точке
+		qint64          mMemoryUsage;       // Объем памяти, занимаемый командой
 	};
 
-	// Загружает сцену из бинарного потока
-	bool load(QDataStream &stream);
+	// Создает запись состояния, сжимая сериализованные данные при необходимости
+	static UndoRecord packUndoRecord(const QByteArray &data, const QList<quint32> &children = QList<quint32>());
 
-	// Сохраняет сцену в бинарный поток
-	bool save(QDataStream &stream);
+	// Возвращает распакованные сериализованные данные записи состояния
+	static QByteArray unpackUndoRecord(const UndoRecord &record);
+
+	// Проверяет совпадение записей состояния
+	static bool isUndoRecordEqual(const UndoRecord &record1, const UndoRecord &record2);
+
+	// Возвращает объем памяти, занимаемый записями состояния, учитывая данные записей или только служебные расходы
+	static qint64 getUndoRecordsMemoryUsage(const UndoRecordMap &records, bool withData);
+
+	// Загружает сцену из Lua скрипта
+	bool loadScript(const QString &fileName);
+
+	// Сохраняет сцену в Lua скрипт
+	bool saveScript(const QString &fileName);
+
+	// Возвращает имя файла бинарного кэша для файла сцены
+	static QString getCacheFileName(const QString &fileName);
+
+	// Вычисляет хеш содержимого файла
+	static QByteArray getFileHash(const QString &fileName);
+
+	// Читает бинарное представление сцены из кэша, если он соответствует файлу сцены
+	static QByteArray readCache(const QString &fileName);
+
+	// Разбирает Lua скрипт сцены в бинарное представление во временной сцене без загрузки ресурсов объектов
+	static QByteArray parseScript(const QString &fileName);
+
+	// Сохраняет в бинарный кэш рядом с файлом сцены бинарное представление, разобранное из этого файла
+	static bool saveCache(const QString &fileName);
+
+	// Сохраняет сцену в бинарное представление
+	bool saveData(QDataStream &stream);
+
+	// Возвращает команду отмены по индексу состояния в стеке отмен
+	const UndoCommand *getUndoCommand(int index) const;
+
+	// Записывает изменившиеся с прошлой записи слои и объекты и общие свойства сцены
+	void recordUndoChanges(UndoRecordMap &oldRecords, UndoRecordMap &newRecords, QByteArray &oldHeader, QByteArray &newHeader);
+
+	// Рекурсивно записывает изменившиеся слои и объекты
+	void recordLayerChanges(BaseLayer *layer, UndoRecordMap &oldRecords, UndoRecordMap &newRecords, QList<quint32> &removedKeys, QSet<quint32> &attachedKeys);
+
+	// Заменяет запись состояния, запоминая исходную и новую запись в списках изменений
+	void replaceUndoRecord(quint32 key, const UndoRecord &record, UndoRecordMap &oldRecords, UndoRecordMap &newRecords);
+
+	// Переводит записи состояния сцены от текущего индекса в стеке отмен к заданному, запоминая ключи измененных записей
+	void moveUndoRecords(int index, QSet<quint32> &changedKeys);
+
+	// Удаляет старейшие команды из стека отмен при превышении ограничения памяти для истории отмен
+	void trimUndoStack();
+
+	// Восстанавливает сцену по записям состояния, обновляя на месте только измененные слои и объекты
+	bool patchUndoRecords(QSet<quint32> changedKeys);
+
+	// Рекурсивно собирает слои и объекты по ключам, добавляя ключи незаписанных изменений
+	void collectUndoElements(BaseLayer *layer, QHash<quint32, BaseLayer *> &layers, QHash<quint32, GameObject *> &objects, QSet<quint32> &changedKeys);
+
+	// Возвращает слой по ключу, создавая его по записи состояния при отсутствии
+	BaseLayer *findOrCreateLayer(quint32 key, QHash<quint32, BaseLayer *> &layers, QList<BaseLayer *> &createdLayers);
+
+	// Возвращает игровой объект по ключу, создавая его по записи состояния при отсутствии
+	GameObject *findOrCreateGameObject(quint32 key, QHash<quint32, GameObject *> &objects);
+
+	// Приводит список дочерних слоев или объектов слоя в соответствие с записью состояния
+	void patchLayerChildren(BaseLayer *layer, QHash<quint32, BaseLayer *> &layers, QHash<quint32, GameObject *> &objects,
+		QList<BaseLayer *> &createdLayers, QList<BaseLayer *> &detachedLayers, QList<GameObject *> &detachedObjects);
+
+	// Проверяет, что слой присоединен к корневому слою сцены
+	bool isLayerAttached(BaseLayer *layer) const;
+
+	// Восстанавливает сцену по записям состояния целиком
+	bool restoreUndoRecords();
+
+	// Рекурсивно создает слой по записи состояния
+	BaseLayer *restoreLayer(quint32 key, QHash<quint32, BaseLayer *> &layers);
+
+	// Сохраняет общие свойства сцены в массив байт
+	QByteArray saveHeader();
 
 	BaseLayer       *mRootLayer;        // Корневой слой
 	BaseLayer       *mActiveLayer;      // Текущий активный слой
@@ -146,6 +315,16 @@ private:
 	QUndoStack      *mUndoStack;        // Текущий стек отмен
 	int             mCommandIndex;      // Индекс текущей команды в стеке отмен
 	UndoCommand     *mInitialState;     // Начальное состояние сцены
+	UndoRecordMap   mUndoRecords;       // Записи состояния слоев и объектов на момент текущей команды
+	QByteArray      mUndoHeader;        // Общие свойства сцены на момент текущей команды
+	quint32         mUndoKeyIndex;      // Текущий индекс для генерации ключей слоев и объектов в истории отмен
+	bool            mTrimmingUndoStack; // Флаг пересоздания стека отмен при удалении старейших команд
+	qint64          mUndoMemoryUsage;   // Объем памяти, занимаемый начальным состоянием и командами стека отмен
+	bool            mLoadResources;     // Флаг загрузки ресурсов игровых объектов, сброшенный во временных сценах рабочих потоков
+
+	QList<GameObject *> mRestoredObjects;   // Объекты, созданные или перезагруженные при последней отмене/повторе
+	QSet<BaseLayer *>   mRestoredLayers;    // Слои с измененным списком или свойствами объектов при последней отмене/повторе
+	bool                mLayerTreeRestored; // Флаг изменения дерева слоев при последней отмене/повторе
 
 	int             mObjectIndex;       // Текущий индекс для генерации уникальных идентификаторов объектов
 	int             mLayerIndex;        // Текущий индекс для генерации имен слоев
@@ -157,4 +336,11 @@ private:
 	QList<qreal>    mVertGuides;        // Вертикальные направляющие
 };
 
+// Снимок состояния сцены для сохранения в рабочем потоке
+struct Scene::Snapshot
+{
+	UndoRecordMap   mRecords;   // Записи состояния слоев и объектов
+	QByteArray      mHeader;    // Общие свойства сцены
+};
+
 #endif // SCENE_H
@@ -0,0 +1,56 @@
+#ifndef SNAP_INDEX_H
+#define SNAP_INDEX_H
+
+class GameObject;
+
+// Класс индекса краев игровых объектов для привязки к умным направляющим
+class SnapIndex
+{
+public:
+
+	// Конструктор
+	SnapIndex();
+
+	// Проверяет, что индекс построен
+	bool isBuilt() const;
+
+	// Строит индекс по списку игровых объектов от верхнего к нижнему
+	void build(const QList<GameObject *> &objects);
+
+	// Очищает индекс
+	void clear();
+
+	// Привязывает X координату к ближайшему краю или центру объектов, не входящих в список исключенных
+	void snapXCoord(qreal x, qreal y1, qreal y2, const QSet<GameObject *> &excludedObjects, qreal &snappedX, qreal &distance, QLineF &line) const;
+
+	// Привязывает Y координату к ближайшему краю или центру объектов, не входящих в список исключенных
+	void snapYCoord(qreal y, qreal x1, qreal x2, const QSet<GameObject *> &excludedObjects, qreal &snappedY, qreal &distance, QLineF &line) const;
+
+private:
+
+	// Край или центр игрового объекта вдоль одной из осей
+	struct Edge
+	{
+		qreal       mCoord;     // Координата края
+		qreal       mMin;       // Начало отрезка края по другой оси
+		qreal       mMax;       // Конец отрезка края по другой оси
+		int         mPriority;  // Приоритет края внутри объекта: центр, затем левый или верхний край, затем правый или нижний
+		int         mOrder;     // Порядковый номер объекта от верхнего к нижнему
+		GameObject  *mObject;   // Указатель на игровой объект
+	};
+
+	// Сравнивает края по координате
+	static bool edgeLessThan(const Edge &edge1, const Edge &edge2);
+
+	// Добавляет край в массив
+	static void addEdge(QVector<Edge> &edges, qreal coord, qreal min, qreal max, int priority, int order, GameObject *object);
+
+	// Ищет ближайший к координате край на расстоянии меньше заданного
+	static const Edge *findNearestEdge(const QVector<Edge> &edges, qreal coord, qreal distance, const QSet<GameObject *> &excludedObjects);
+
+	QVector<Edge>   mXEdges;    // Отсортированные по X левые края, центры и правые края объектов
+	QVector<Edge>   mYEdges;    // Отсортированные по Y верхние края, центры и нижние края объектов
+	bool            mBuilt;     // Флаг построенного индекса
+};
+
+#endif // SNAP_INDEX_H
@@ -0,0 +1,51 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+class GameObject;
+
+// Класс пространственного индекса игровых объектов на основе равномерной сетки
+class SpatialIndex
+{
+public:
+
+	// Конструктор
+	SpatialIndex();
+
+	// Добавляет игровой объект в индекс
+	void insert(GameObject *object);
+
+	// Удаляет игровой объект из индекса
+	void remove(GameObject *object);
+
+	// Обновляет положение игрового объекта в индексе после изменения его ограничивающего прямоугольника
+	void update(GameObject *object);
+
+	// Ищет игровые объекты, ограничивающий прямоугольник которых содержит заданную точку
+	QList<GameObject *> findObjects(const QPointF &pt) const;
+
+	// Ищет игровые объекты, ограничивающий прямоугольник которых пересекается с заданным прямоугольником
+	QList<GameObject *> findObjects(const QRectF &rect) const;
+
+private:
+
+	static const int CELL_SIZE = 256;           // Размер ячейки сетки в пикселях
+	static const int MAX_OBJECT_CELLS = 64;     // Максимальное количество ячеек, занимаемых одним объектом
+
+	// Возвращает прямоугольник ячеек, покрывающих заданный прямоугольник
+	static QRect getCellRect(const QRectF &rect);
+
+	// Возвращает ключ ячейки по ее координатам
+	static quint64 getCellKey(int x, int y);
+
+	// Добавляет игровой объект в ячейки заданного прямоугольника
+	void insertIntoCells(GameObject *object, const QRect &cellRect);
+
+	// Удаляет игровой объект из ячеек заданного прямоугольника
+	void removeFromCells(GameObject *object, const QRect &cellRect);
+
+	QHash<quint64, QList<GameObject *> >    mCells;         // Списки объектов в непустых ячейках сетки
+	QHash<GameObject *, QRect>              mObjectCells;   // Прямоугольники ячеек, занимаемых объектами
+	QSet<GameObject *>                      mLargeObjects;  // Объекты, занимающие слишком много ячеек
+};
+
+#endif // SPATIAL_INDEX_H
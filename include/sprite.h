@@ -42,6 +42,9 @@ public:
 	// Загружает объект из бинарного потока
 	virtual bool load(QDataStream &stream);
 
+	// Загружает локализованные текстуры
+	virtual void loadResources();
+
 	// Сохраняет объект в бинарный поток
 	virtual bool save(QDataStream &stream);
 
@@ -52,7 +55,7 @@ public:
 	virtual bool save(QTextStream &stream, int indent);
 
 	// Устанавливает текущий язык для объекта
-	virtual void setCurrentLanguage(const QString &language);
+	virtual void setCurrentLanguage(int language);
 
 	// Определяет, локализован ли объект для текущего языка
 	virtual bool isLocalized() const;
@@ -70,15 +73,20 @@ public:
 	virtual bool changeTexture(const QString &fileName, const QSharedPointer<Texture> &texture);
 
 	// Отрисовывает объект
-	virtual void draw();
+	virtual void draw(SpriteBatch &batch);
+
+protected:
+
+	// Загружает свойство спрайта по индексу ключа из значения на вершине стека, увеличивая счетчик загруженных свойств
+	virtual bool loadProperty(LuaScript &script, int key, int &numProperties);
 
 private:
 
-	// Тип для списка локализованных текстур
-	typedef QMap<QString, QSharedPointer<Texture> > TextureMap;
+	// Количество обязательных свойств спрайта
+	static const int NUM_PROPERTIES = GameObject::NUM_PROPERTIES + 4;
 
-	// Загружает локализованные текстуры
-	void loadTextures();
+	// Тип для списка локализованных текстур
+	typedef LocalizedArray<QSharedPointer<Texture> > TextureMap;
 
 	QString                 mFileName;          // Имя файла с текстурой
 	QSharedPointer<Texture> mTexture;           // Текстура спрайта
@@ -0,0 +1,45 @@
+#ifndef SPRITE_BATCH_H
+#define SPRITE_BATCH_H
+
+class Texture;
+
+// Класс пакетной отрисовки спрайтов
+class SpriteBatch
+{
+public:
+
+	// Конструктор
+	SpriteBatch();
+
+	// Добавляет в пакет текстурированный квад с вершинами в мировых координатах
+	void addQuad(const Texture *texture, const QPointF *vertices, const QColor &color);
+
+	// Отрисовывает накопленные квады одним вызовом и очищает пакет
+	void flush();
+
+	// Учитывает объекты, отброшенные при отсечении по видимой области
+	void addCulledObjects(int count);
+
+	// Возвращает количество отброшенных объектов с момента сброса счетчика
+	int getNumCulledObjects() const;
+
+	// Сбрасывает счетчик отброшенных объектов в заданное значение
+	void resetNumCulledObjects(int count = 0);
+
+private:
+
+	// Вершина квада в формате, пригодном для массивов вершин OpenGL
+	struct Vertex
+	{
+		GLfloat mTexCoord[2];   // Текстурные координаты
+		GLubyte mColor[4];      // Цвет вершины
+		GLfloat mPosition[2];   // Мировые координаты
+	};
+
+	QVector<Vertex> mVertices;          // Буфер вершин
+	int             mNumVertices;       // Количество заполненных вершин в буфере
+	GLuint          mTexture;           // Текстура текущего пакета
+	int             mNumCulledObjects;  // Количество отброшенных объектов
+};
+
+#endif // SPRITE_BATCH_H
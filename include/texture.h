@@ -12,6 +12,12 @@ public:
 	// Конструктор
 	Texture(const QString &fileName);
 
+	// Конструктор, загружающий в OpenGL изображение, подготовленное функцией decodeImage
+	Texture(const QImage &image);
+
+	// Конструктор заглушки, отображающей текстуру по умолчанию с размерами еще не загруженного изображения
+	Texture(const QSize &size, const QSharedPointer<Texture> &defaultTexture);
+
 	// Деструктор
 	~Texture();
 
@@ -21,6 +27,9 @@ public:
 	// Проверяет, что текстура дефолтная
 	bool isDefault() const;
 
+	// Проверяет, что текстура является заглушкой на время асинхронной загрузки изображения
+	bool isPlaceholder() const;
+
 	// Возвращает размер текстуры
 	QSize getSize() const;
 
@@ -30,17 +39,24 @@ public:
 	// Возвращает высоту текстуры
 	int getHeight() const;
 
-	// Рисует текстуру
-	void draw();
+	// Возвращает идентификатор текстуры OpenGL
+	GLuint getHandle() const;
+
+	// Загружает изображение из файла и конвертирует его пиксели в байты RGBA без переворота; может вызываться из рабочего потока
+	static QImage decodeImage(const QString &fileName);
 
 private:
 
 	// Загружает текстуру из файла
 	void load(const QString &fileName);
 
-	GLuint  mHandle;    // Идентификатор текстуры
-	QSize   mSize;      // Размеры текстуры
-	bool    mDefault;   // Флаг текстуры по умолчанию
+	// Создает текстуру OpenGL из изображения в формате OpenGL
+	void upload(const QImage &image);
+
+	GLuint                  mHandle;            // Идентификатор текстуры
+	QSize                   mSize;              // Размеры текстуры
+	bool                    mDefault;           // Флаг текстуры по умолчанию
+	QSharedPointer<Texture> mDefaultTexture;    // Текстура по умолчанию, отображаемая заглушкой
 };
 
 #endif // TEXTURE_H
@@ -1,51 +1,34 @@
 #ifndef TEXTURE_LOADER_H
 #define TEXTURE_LOADER_H
 
-#include "project.h"
 #include "texture.h"
 #include "utils.h"
 
-// Класс для загрузки текстур в фоновом потоке
-class TextureLoader : public QObject
+// Класс задачи декодирования изображения текстуры в пуле потоков
+class TextureLoader : public QRunnable
 {
-	Q_OBJECT
-
 public:
 
 	// Конструктор
-	TextureLoader(QGLWidget *secondaryGLWidget)
-	: mSecondaryGLWidget(secondaryGLWidget)
+	TextureLoader(QObject *receiver, const QString &fileName, const QString &path)
+	: mReceiver(receiver), mFileName(fileName), mPath(path)
 	{
 	}
 
-public slots:
-
-	// Обработчик сигнала добавления текстуры в очередь на загрузку
-	void onTextureQueued(QString fileName)
+	// Декодирует изображение и передает его получателю в главный поток для загрузки в OpenGL
+	virtual void run()
 	{
-		// загружаем текстуру и отправляем сигнал о завершении загрузки
-		QSharedPointer<Texture> texture;
-		QString path = Project::getSingleton().getRootDirectory() + fileName;
-		if (Utils::fileExists(path))
-		{
-			mSecondaryGLWidget->makeCurrent();
-			texture = QSharedPointer<Texture>(new Texture(path));
-			if (!texture->isLoaded())
-				texture.clear();
-			mSecondaryGLWidget->doneCurrent();
-		}
-		emit textureLoaded(fileName, texture);
+		QImage image;
+		if (Utils::fileExists(mPath))
+			image = Texture::decodeImage(mPath);
+		QMetaObject::invokeMethod(mReceiver, "onImageDecoded", Qt::QueuedConnection, Q_ARG(QString, mFileName), Q_ARG(QImage, image));
 	}
 
-signals:
-
-	// Сигнал о завершении загрузки текстуры
-	void textureLoaded(QString fileName, QSharedPointer<Texture> texture);
-
 private:
 
-	// OpenGL виджет для загрузки текстур в фоновом потоке
-	QGLWidget *mSecondaryGLWidget;
+	QObject *mReceiver;     // Получатель декодированного изображения
+	QString mFileName;      // Имя файла текстуры относительно корневого каталога проекта
+	QString mPath;          // Полный путь к файлу текстуры
 };
 
 #endif // TEXTURE_LOADER_H
@@ -4,8 +4,6 @@
 #include "singleton.h"
 #include "texture.h"
 
-class TextureLoader;
-
 // Глобальный класс для загрузки и хранения текстур
 class TextureManager : public Singleton<TextureManager>
 {
@@ -13,25 +11,26 @@ class TextureManager : public Singleton<TextureManager>
 
 public:
 
+	// Тип для набора текстур по именам файлов
+	typedef QMap<QString, QSharedPointer<Texture> > TextureMap;
+
 	// Конструктор
-	TextureManager(QGLWidget *primaryGLWidget, QGLWidget *secondaryGLWidget);
+	TextureManager(QGLWidget *primaryGLWidget);
 
 	// Деструктор
 	virtual ~TextureManager();
 
-	// Загружает текстуру и возвращает указатель на нее
-	QSharedPointer<Texture> loadTexture(const QString &fileName, bool useDefaultTexture = true);
+	// Загружает текстуру и возвращает указатель на нее; в асинхронном режиме возвращает заглушку с размерами изображения,
+	// а загруженная текстура передается сигналом texturesChanged
+	QSharedPointer<Texture> loadTexture(const QString &fileName, bool useDefaultTexture = true, bool async = false);
 
 	// Устанавливает текущий контекст OpenGL
 	void makeCurrent();
 
 signals:
 
-	// Сигнал изменения текстуры
-	void textureChanged(const QString &fileName, const QSharedPointer<Texture> &texture);
-
-	// Сигнал добавления текстуры в очередь на загрузку
-	void textureQueued(QString fileName);
+	// Сигнал изменения текстур, загруженных за один интервал загрузки
+	void texturesChanged(const TextureManager::TextureMap &textures);
 
 protected:
 
@@ -43,33 +42,65 @@ private slots:
 	// Обработчик изменения файла
 	void onFileChanged(const QString &path);
 
+	// Обработчик изменения содержимого каталога
+	void onDirectoryChanged(const QString &path);
+
+	// Обработчик таймера, отправляющего на загрузку файлы, изменения которых завершились
+	void onChangeTimeout();
+
 	// Обработчик завершения загрузки текстуры
 	void onTextureLoaded(QString fileName, QSharedPointer<Texture> texture);
 
+	// Обработчик завершения декодирования изображения текстуры в пуле потоков
+	void onImageDecoded(QString fileName, QImage image);
+
+	// Обработчик таймера загрузки декодированных изображений в OpenGL
+	void onUploadTimeout();
+
 private:
 
+	static const int UPLOAD_INTERVAL = 16;      // Интервал загрузки изображений в OpenGL в миллисекундах
+	static const int UPLOAD_TIME_BUDGET = 8;    // Время, отводимое на загрузку изображений за один интервал, в миллисекундах
+	static const int CHANGE_DELAY = 250;        // Задержка перезагрузки измененных файлов в миллисекундах
+	static const int PRUNE_INTERVAL = 10000;    // Интервал удаления неиспользуемых текстур из кэша в миллисекундах
+
+	// Ставит на слежение каталог текстуры и, если нужно, сам файл текстуры
+	void watchTexture(const QString &path, bool watchFile);
+
+	// Отправляет текстуру на декодирование, объединяя повторные запросы для одного файла
+	void queueTexture(const QString &fileName, bool changed);
+
+	// Выдает один сигнал для всех загруженных текстур и заменяет ими текстуры в кэше
+	void emitTexturesChanged();
+
 	// Структура с информацией о текстуре
 	struct TextureInfo
 	{
 		// Конструктор
 		TextureInfo(const QSharedPointer<Texture> &texture)
-		: mTexture(texture), mChanged(false)
+		: mTexture(texture)
 		{
 		}
 
 		QWeakPointer<Texture>   mTexture;       // Слабая ссылка на загруженную текстуру
-		bool                    mChanged;       // Флаг изменения текстуры
-		QElapsedTimer           mTimer;         // Таймер для отсчета времени с момента последнего изменения текстуры
 	};
 
 	// Тип для текстурного кэша
 	typedef QMap<QString, TextureInfo> TextureCache;
 
 	QGLWidget               *mPrimaryGLWidget;      // OpenGL виджет для загрузки текстур в главном потоке
-	QThread                 *mBackgroundThread;     // Фоновый поток
-	TextureLoader           *mTextureLoader;        // Загрузчик текстур
+	QSharedPointer<Texture> mDefaultTexture;        // Текстура по умолчанию, разделяемая заглушками
+	QThreadPool             *mDecodePool;           // Пул потоков для декодирования изображений
+	QTimer                  *mUploadTimer;          // Таймер загрузки декодированных изображений в OpenGL
+	QHash<QString, bool>    mDecodingTextures;      // Декодируемые текстуры с флагом изменения файла во время декодирования
+	QMap<QString, QImage>   mDecodedImages;         // Декодированные изображения, ожидающие загрузки в OpenGL
 	QFileSystemWatcher      *mWatcher;              // Объект слежения за файловой системой
+	QSet<QString>           mWatchedFiles;          // Файлы текстур на слежении
+	QSet<QString>           mWatchedDirectories;    // Каталоги текстур на слежении
+	QSet<QString>           mChangedTextures;       // Текстуры, файлы которых изменились и ожидают перезагрузки
+	QTimer                  *mChangeTimer;          // Таймер перезагрузки измененных файлов
 	TextureCache            mTextureCache;          // Текстурный кэш
+	TextureMap              mLoadedTextures;        // Загруженные текстуры, ожидающие замены в объектах
 };
 
 #endif // TEXTURE_MANAGER_H
@@ -53,6 +53,12 @@ public:
 
 	// Записывает шапку текстового Lua-файла
 	static void writeFileHeader(QTextStream &stream);
+
+	// Записывает вещественное число в текстовый поток с точностью до 8 значащих цифр
+	static void writeReal(QTextStream &stream, qreal value);
+
+	// Записывает данные во временный файл и атомарно заменяет им заданный файл
+	static bool writeFileAtomically(const QString &fileName, const QByteArray &data);
 };
 
 #endif // UTILS_H
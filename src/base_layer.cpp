@@ -1,15 +1,17 @@
 #include "pch.h"
 #include "base_layer.h"
+#include "layer.h"
 #include "lua_script.h"
 #include "utils.h"
 
 BaseLayer::BaseLayer()
-: mParentLayer(NULL)
+: mParentLayer(NULL), mUndoKey(0), mUndoDirty(true), mBoundingRectValid(false)
 {
 }
 
 BaseLayer::BaseLayer(const QString &name, BaseLayer *parent, int index)
-: mName(name), mVisibleState(LAYER_VISIBLE), mLockState(LAYER_UNLOCKED), mExpanded(false), mParentLayer(NULL)
+: mName(name), mVisibleState(LAYER_VISIBLE), mLockState(LAYER_UNLOCKED), mExpanded(false), mParentLayer(NULL), mUndoKey(0), mUndoDirty(true),
+  mBoundingRectValid(false)
 {
 	// добавляем себя в родительский слой
 	if (parent != NULL)
@@ -17,7 +19,8 @@ BaseLayer::BaseLayer(const QString &name, BaseLayer *parent, int index)
 }
 
 BaseLayer::BaseLayer(const BaseLayer &layer)
-: mName(layer.mName), mVisibleState(layer.mVisibleState), mLockState(layer.mLockState), mExpanded(layer.mExpanded), mThumbnail(layer.mThumbnail), mParentLayer(NULL)
+: mName(layer.mName), mVisibleState(layer.mVisibleState), mLockState(layer.mLockState), mExpanded(layer.mExpanded), mThumbnail(layer.mThumbnail), mParentLayer(NULL),
+  mUndoKey(0), mUndoDirty(true), mBoundingRectValid(false)
 {
 	// дублируем все дочерние слои
 	for (int i = layer.mChildLayers.size() - 1; i >= 0; --i)
@@ -26,13 +29,13 @@ BaseLayer::BaseLayer(const BaseLayer &layer)
 
 BaseLayer::~BaseLayer()
 {
-	// удаляемся из родительского слоя
-	if (mParentLayer != NULL)
-		mParentLayer->removeChildLayer(mParentLayer->indexOfChildLayer(this));
-
-	// удаляем все дочерние слои
+	// удаляем все дочерние слои, пока слой присоединен к дереву, чтобы их игровые объекты удалились из индекса имен дерева
 	while (!mChildLayers.empty())
 		delete mChildLayers.front();
+
+	// удаляемся из родительского слоя; игровых объектов в поддереве уже нет, а виртуальные функции в деструкторе недоступны
+	if (mParentLayer != NULL)
+		mParentLayer->detachChildLayer(mParentLayer->indexOfChildLayer(this));
 }
 
 QString BaseLayer::getName() const
@@ -43,6 +46,7 @@ QString BaseLayer::getName() const
 void BaseLayer::setName(const QString &name)
 {
 	mName = name;
+	mUndoDirty = true;
 }
 
 BaseLayer::VisibleState BaseLayer::getVisibleState() const
@@ -53,6 +57,7 @@ BaseLayer::VisibleState BaseLayer::getVisibleState() const
 void BaseLayer::setVisibleState(VisibleState visibleState)
 {
 	mVisibleState = visibleState;
+	mUndoDirty = true;
 }
 
 BaseLayer::LockState BaseLayer::getLockState() const
@@ -63,6 +68,7 @@ BaseLayer::LockState BaseLayer::getLockState() const
 void BaseLayer::setLockState(LockState lockState)
 {
 	mLockState = lockState;
+	mUndoDirty = true;
 }
 
 bool BaseLayer::isExpanded() const
@@ -73,6 +79,7 @@ bool BaseLayer::isExpanded() const
 void BaseLayer::setExpanded(bool expanded)
 {
 	mExpanded = expanded;
+	mUndoDirty = true;
 }
 
 QIcon BaseLayer::getThumbnail() const
@@ -143,12 +150,86 @@ void BaseLayer::insertChildLayer(int index, BaseLayer *layer)
 	{
 		layer->setParentLayer(this);
 		mChildLayers.insert(index, layer);
+		mUndoDirty = true;
+		invalidateBoundingRect();
+
+		// переносим имена игровых объектов присоединенного поддерева в индекс имен дерева
+		getTreeNameIndex().takeFrom(layer->mNameIndex);
 	}
 }
 
 void BaseLayer::removeChildLayer(int index)
 {
-	mChildLayers.takeAt(index)->setParentLayer(NULL);
+	// переносим имена игровых объектов отсоединяемого поддерева из индекса имен дерева в собственный индекс поддерева
+	BaseLayer *layer = mChildLayers[index];
+	NameIndex &nameIndex = getTreeNameIndex();
+	foreach (GameObject *object, layer->getGameObjects())
+	{
+		nameIndex.remove(object->getName(), object);
+		layer->mNameIndex.insert(object->getName(), object);
+	}
+
+	detachChildLayer(index);
+}
+
+GameObject *BaseLayer::findGameObjectByName(const QString &name) const
+{
+	// выбираем среди объектов с заданным именем во всем дереве лежащий в этом слое или его дочерних слоях
+	foreach (GameObject *object, getTreeNameIndex().findAll(name))
+		for (const BaseLayer *layer = object->getParentLayer(); layer != NULL; layer = layer->mParentLayer)
+			if (layer == this)
+				return object;
+
+	return NULL;
+}
+
+int BaseLayer::findFreeCopyIndex(const QString &baseName, int index) const
+{
+	return getTreeNameIndex().findFreeCopyIndex(baseName, index);
+}
+
+void BaseLayer::invalidateBoundingRect()
+{
+	// поднимаемся вверх по иерархии, пока не встретим уже сброшенный прямоугольник:
+	// у такого слоя все родительские прямоугольники тоже сброшены
+	for (BaseLayer *layer = this; layer != NULL && layer->mBoundingRectValid; layer = layer->mParentLayer)
+		layer->mBoundingRectValid = false;
+}
+
+NameIndex &BaseLayer::getTreeNameIndex()
+{
+	BaseLayer *layer = this;
+	while (layer->mParentLayer != NULL)
+		layer = layer->mParentLayer;
+	return layer->mNameIndex;
+}
+
+const NameIndex &BaseLayer::getTreeNameIndex() const
+{
+	const BaseLayer *layer = this;
+	while (layer->mParentLayer != NULL)
+		layer = layer->mParentLayer;
+	return layer->mNameIndex;
+}
+
+quint32 BaseLayer::getUndoKey() const
+{
+	return mUndoKey;
+}
+
+void BaseLayer::setUndoKey(quint32 key)
+{
+	mUndoKey = key;
+}
+
+bool BaseLayer::isUndoDirty() const
+{
+	return mUndoDirty;
+}
+
+void BaseLayer::setUndoDirty(bool dirty)
+{
+	mUndoDirty = dirty;
 }
 
 bool BaseLayer::load(QDataStream &stream)
@@ -193,3 +274,10 @@ bool BaseLayer::save(QTextStream &stream, int indent)
 		<< ", expanded = " << (mExpanded ? "true" : "false");
 	return stream.status() == QTextStream::Ok;
 }
+
+void BaseLayer::detachChildLayer(int index)
+{
+	mChildLayers.takeAt(index)->setParentLayer(NULL);
+	mUndoDirty = true;
+	invalidateBoundingRect();
+}
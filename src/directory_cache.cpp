@@ -0,0 +1,131 @@
+#include "pch.h"
+#include "directory_cache.h"
+
+template<> DirectoryCache *Singleton<DirectoryCache>::mSingleton = NULL;
+
+DirectoryCache::DirectoryCache()
+{
+	// создаем объект слежения за закэшированными каталогами
+	mWatcher = new QFileSystemWatcher(this);
+	connect(mWatcher, SIGNAL(directoryChanged(const QString &)), this, SLOT(onDirectoryChanged(const QString &)));
+
+	// запускаем таймер удаления неиспользуемых каталогов из кэша
+	startTimer(PRUNE_INTERVAL);
+}
+
+bool DirectoryCache::fileExists(const QString &path)
+{
+	// ищем содержимое каталога в кэше
+	QFileInfo fileInfo(path);
+	QString directory = fileInfo.absolutePath();
+	{
+		QReadLocker locker(&mLock);
+		QHash<QString, DirectoryInfo>::const_iterator it = mDirectories.find(directory);
+		if (it != mDirectories.end())
+		{
+			it->mUsed = 1;
+			return it->mFileNames.contains(fileInfo.fileName());
+		}
+	}
+
+	// не кэшируем несуществующие каталоги, чтобы заметить их создание
+	QDir dir(directory);
+	if (!dir.exists())
+		return false;
+
+	// в главном потоке ставим каталог на слежение до чтения, чтобы не пропустить изменения
+	bool mainThread = QThread::currentThread() == thread();
+	if (mainThread && !mWatchedDirectories.contains(directory))
+	{
+		mWatchedDirectories.insert(directory);
+		mWatcher->addPath(directory);
+	}
+
+	// читаем каталог один раз до следующего изменения
+	DirectoryInfo info;
+	info.mFileNames = readDirectory(dir);
+	info.mUsed = 1;
+	{
+		QWriteLocker locker(&mLock);
+
+		// рабочий поток не заменяет содержимое, прочитанное тем временем другим потоком
+		QHash<QString, DirectoryInfo>::const_iterator it = mDirectories.find(directory);
+		if (!mainThread && it != mDirectories.end())
+			return it->mFileNames.contains(fileInfo.fileName());
+		mDirectories.insert(directory, info);
+	}
+
+	// слежение возможно только в главном потоке, поэтому рабочий поток передает каталог ему
+	if (!mainThread)
+		QMetaObject::invokeMethod(this, "onDirectoryRead", Qt::QueuedConnection, Q_ARG(QString, directory));
+	return info.mFileNames.contains(fileInfo.fileName());
+}
+
+void DirectoryCache::invalidate(const QString &directory)
+{
+	QWriteLocker locker(&mLock);
+	mDirectories.remove(QFileInfo(directory).absoluteFilePath());
+}
+
+void DirectoryCache::timerEvent(QTimerEvent *event)
+{
+	// удаляем из кэша и снимаем со слежения каталоги, к которым не было обращений с прошлой очистки
+	QWriteLocker locker(&mLock);
+	QHash<QString, DirectoryInfo>::iterator it = mDirectories.begin();
+	while (it != mDirectories.end())
+	{
+		if (it->mUsed.fetchAndStoreRelaxed(0) == 0)
+		{
+			unwatchDirectory(it.key());
+			it = mDirectories.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	// снимаем со слежения каталоги, содержимое которых было сброшено и больше не запрашивалось
+	foreach (const QString &directory, mWatchedDirectories)
+		if (!mDirectories.contains(directory))
+			unwatchDirectory(directory);
+}
+
+void DirectoryCache::onDirectoryRead(const QString &directory)
+{
+	// пропускаем каталоги, уже стоящие на слежении или удаленные из кэша
+	if (mWatchedDirectories.contains(directory))
+		return;
+	{
+		QReadLocker locker(&mLock);
+		if (!mDirectories.contains(directory))
+			return;
+	}
+
+	// ставим каталог на слежение и сбрасываем его содержимое, так как изменения до этого момента могли быть пропущены
+	mWatchedDirectories.insert(directory);
+	mWatcher->addPath(directory);
+	invalidate(directory);
+}
+
+void DirectoryCache::onDirectoryChanged(const QString &path)
+{
+	// удаленный каталог снимается со слежения автоматически, поэтому забываем о нем
+	QString directory = QFileInfo(path).absoluteFilePath();
+	if (!QDir(directory).exists())
+		unwatchDirectory(directory);
+
+	// сбрасываем закэшированное содержимое каталога
+	invalidate(directory);
+}
+
+QSet<QString> DirectoryCache::readDirectory(const QDir &dir)
+{
+	return dir.entryList(QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot).toSet();
+}
+
+void DirectoryCache::unwatchDirectory(const QString &directory)
+{
+	if (mWatchedDirectories.remove(directory))
+		mWatcher->removePath(directory);
+}
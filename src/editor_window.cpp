@@ -1,6 +1,7 @@
 #include "pch.h"
 #include "editor_window.h"
 #include "game_object.h"
+#include "label.h"
 #include "layer.h"
 #include "options.h"
 #include "project.h"
@@ -10,7 +11,9 @@
 
 EditorWindow::EditorWindow(QWidget *parent, QGLWidget *shareWidget, const QString &fileName, QWidget *spriteWidget, QWidget *fontWidget)
 : QGLWidget(shareWidget->format(), parent, shareWidget), mFileName(fileName), mUntitled(true), mEditorState(STATE_IDLE),
-  mCameraPos(0.0, 0.0), mZoom(1.0), mSpriteWidget(spriteWidget), mFontWidget(fontWidget)
+  mLanguageVersion(Project::getSingleton().getLanguageVersion()),
+  mCameraPos(0.0, 0.0), mZoom(1.0), mBelowSelectionBuffer(NULL), mAboveSelectionBuffer(NULL), mSelectionCacheValid(false),
+  mSelectionCacheZoom(1.0), mSelectionCacheCulledObjects(0), mBlendFuncSeparate(NULL), mSpriteWidget(spriteWidget), mFontWidget(fontWidget)
 {
 	// разрешаем события клавиатуры и перемещения мыши
 	setFocusPolicy(Qt::StrongFocus);
@@ -28,6 +31,11 @@ EditorWindow::EditorWindow(QWidget *parent, QGLWidget *shareWidget, const QStrin
 	// создаем курсор поворота
 	mRotateCursor = QCursor(QPixmap(":/images/rotate_cursor.png"));
 
+	// создаем таймер отложенной перерисовки
+	mRepaintTimer = new QTimer(this);
+	mRepaintTimer->setSingleShot(true);
+	connect(mRepaintTimer, SIGNAL(timeout()), this, SLOT(update()));
+
 	// корректируем положение камеры, если включены линейки
 	if (Options::getSingleton().isShowGuides())
 		mCameraPos = QPointF(-RULER_SIZE, -RULER_SIZE);
@@ -37,12 +45,19 @@ EditorWindow::EditorWindow(QWidget *parent, QGLWidget *shareWidget, const QStrin
 
 	// создаем новую сцену
 	mScene = new Scene(this);
-	connect(mScene, SIGNAL(undoCommandChanged()), this, SIGNAL(undoCommandChanged()));
+	connect(mScene, SIGNAL(undoCommandChanged()), this, SLOT(onSceneUndoCommandChanged()));
 }
 
-bool EditorWindow::load(const QString &fileName)
+EditorWindow::~EditorWindow()
 {
-	if (mScene->load(fileName))
+	// удаляем кадровые буферы в контексте окна
+	makeCurrent();
+	releaseSelectionCache();
+}
+
+bool EditorWindow::load(const QString &fileName, const QByteArray &data)
+{
+	if (mScene->load(data))
 	{
 		// устанавливаем имя файла
 		mFileName = fileName;
@@ -53,6 +68,20 @@ bool EditorWindow::load(const QString &fileName)
 	return false;
 }
 
+bool EditorWindow::recover(const QString &fileName, bool untitled, const QByteArray &data)
+{
+	if (mScene->load(data))
+	{
+		// устанавливаем имя файла и помечаем сцену измененной, так как она еще не сохранена в файл сцены
+		mFileName = fileName;
+		mUntitled = untitled;
+		mScene->pushCommand("Восстановление");
+		return true;
+	}
+
+	return false;
+}
+
 bool EditorWindow::save(const QString &fileName)
 {
 	if (mScene->save(fileName))
@@ -69,7 +98,18 @@ bool EditorWindow::save(const QString &fileName)
 
 bool EditorWindow::loadTranslationFile(const QString &fileName)
 {
-	return mScene->loadTranslationFile(fileName);
+	bool result = mScene->loadTranslationFile(fileName);
+	invalidateSelectionCache();
+	invalidate();
+	return result;
+}
+
+bool EditorWindow::loadTranslationFile(const QString &fileName, const QList<GameObject *> &objects)
+{
+	bool result = mScene->loadTranslationFile(fileName, objects);
+	invalidateSelectionCache();
+	invalidate();
+	return result;
 }
 
 Scene *EditorWindow::getScene() const
@@ -97,6 +137,11 @@ QUndoStack *EditorWindow::getUndoStack() const
 	return mScene->getUndoStack();
 }
 
+qint64 EditorWindow::getUndoMemoryUsage() const
+{
+	return mScene->getUndoMemoryUsage();
+}
+
 void EditorWindow::pushCommand(const QString &commandName)
 {
 	mScene->pushCommand(commandName);
@@ -117,6 +162,7 @@ void EditorWindow::setZoom(qreal zoom)
 	QPointF size(width(), height());
 	mCameraPos = mCameraPos + size / 2.0 / mZoom - size / 2.0 / zoom;
 	mZoom = zoom;
+	invalidate();
 
 	// обновляем курсор мыши
 	QPointF pos = windowToWorld(mapFromGlobal(QCursor::pos()));
@@ -420,10 +466,17 @@ void EditorWindow::moveDown()
 	}
 }
 
-void EditorWindow::setCurrentLanguage(const QString &language)
+void EditorWindow::updateCurrentLanguage()
 {
-	// устанавливаем новый язык
-	mScene->getRootLayer()->setCurrentLanguage(language);
+	// выходим, если сцена уже переключена на текущий язык
+	if (mLanguageVersion == Project::getSingleton().getLanguageVersion())
+		return;
+	mLanguageVersion = Project::getSingleton().getLanguageVersion();
+
+	// переключаем на новый язык объекты сцены
+	mScene->getRootLayer()->updateCurrentLanguage();
+	invalidateSelectionCache();
+	invalidate();
 
 	// обновляем разрешенные операции редактирования
 	updateAllowedEditorActions();
@@ -446,10 +499,18 @@ QStringList EditorWindow::getMissedFiles() const
 	return mScene->getRootLayer()->getMissedFiles();
 }
 
-void EditorWindow::changeTexture(const QString &fileName, const QSharedPointer<Texture> &texture)
+bool EditorWindow::changeTextures(const TextureManager::TextureMap &textures)
 {
 	// заменяем текстуры во всех объектах
-	QList<GameObject *> objects = mScene->getRootLayer()->changeTexture(fileName, texture);
+	QList<GameObject *> objects;
+	for (TextureManager::TextureMap::const_iterator it = textures.begin(); it != textures.end(); ++it)
+		objects.append(mScene->getRootLayer()->changeTexture(it.key(), *it));
+
+	// перерисовываем окно в любом случае, так как заглушки заменяются загруженными текстурами без изменения объектов
+	invalidateSelectionCache();
+	invalidate();
+	if (objects.empty())
+		return false;
 
 	// пересчитываем прямоугольник выделения и центр вращения
 	if (mEditorState == STATE_IDLE && !mSelectedObjects.empty())
@@ -471,6 +532,7 @@ void EditorWindow::changeTexture(const QString &fileName, const QSharedPointer<T
 	// выдаем сигналы об изменении слоев
 	foreach (BaseLayer *layer, layers)
 		emit layerChanged(mScene, layer);
+	return true;
 }
 
 void EditorWindow::updateSelection(const QPointF &rotationCenter)
@@ -496,7 +558,7 @@ void EditorWindow::updateAllowedEditorActions()
 	}
 
 	// проверяем текущую локаль
-	if (Project::getSingleton().getCurrentLanguage() == Project::getSingleton().getDefaultLanguage())
+	if (Project::getSingleton().getCurrentLanguageId() == Project::getSingleton().getDefaultLanguageId())
 	{
 		// в дефолтной локали разрешаем все операции редактирования
 		mMoveEnabled = true;
@@ -520,11 +582,36 @@ void EditorWindow::updateAllowedEditorActions()
 	}
 }
 
+int EditorWindow::getNumCulledObjects() const
+{
+	return mSpriteBatch.getNumCulledObjects();
+}
+
+void EditorWindow::invalidate()
+{
+	// при перетаскивании объектов или камеры ограничиваем частоту перерисовки
+	int maxFrameRate = Options::getSingleton().getMaxDragFrameRate();
+	bool dragging = mEditorState != STATE_IDLE || (QApplication::mouseButtons() & Qt::RightButton) != 0;
+	if (dragging && maxFrameRate > 0 && mFrameTimer.isValid())
+	{
+		// откладываем перерисовку, если с момента последнего кадра прошло слишком мало времени
+		qint64 remainingTime = 1000 / maxFrameRate - mFrameTimer.elapsed();
+		if (remainingTime > 0)
+		{
+			if (!mRepaintTimer->isActive())
+				mRepaintTimer->start(remainingTime);
+			return;
+		}
+	}
+
+	update();
+}
+
 void EditorWindow::paintEvent(QPaintEvent *event)
 {
-	// очищаем окно
-	qglClearColor(QColor(33, 40, 48));
-	glClear(GL_COLOR_BUFFER_BIT);
+	// запоминаем время отрисовки кадра и отменяем отложенную перерисовку
+	mFrameTimer.start();
+	mRepaintTimer->stop();
 
 	// устанавливаем стандартную систему координат (0, 0, width, height) с началом координат в левом верхнем углу
 	glViewport(0, 0, width(), height());
@@ -541,110 +628,45 @@ void EditorWindow::paintEvent(QPaintEvent *event)
 	// определение видимой области
 	QRectF visibleRect(mCameraPos.x(), mCameraPos.y(), width() / mZoom, height() / mZoom);
 
-	// рисуем сетку
-	Options &options = Options::getSingleton();
-	if (options.isShowGrid())
-	{
-		// подбираем подходящий шаг сетки
-		int gridSpacing = options.getGridSpacing();
-		while (gridSpacing * mZoom < MIN_GRID_SPACING)
-			gridSpacing *= GRID_SPACING_COEFF;
-
-		// определение номеров линий для отрисовки
-		int left = static_cast<int>(visibleRect.left() / gridSpacing);
-		int top = static_cast<int>(visibleRect.top() / gridSpacing);
-		int right = static_cast<int>(visibleRect.right() / gridSpacing);
-		int bottom = static_cast<int>(visibleRect.bottom() / gridSpacing);
-
-		// устанавливаем сдвиг в 0.5 пикселя
-		glPushMatrix();
-		glTranslated(0.5 / mZoom, 0.5 / mZoom, 0.0);
-
-		// рисуем сетку из линий или точек
-		int interval = options.getMajorLinesInterval();
-		if (!options.isShowDots())
-		{
-			glBegin(GL_LINES);
-
-			// рисуем вспомогательные линии
-			qglColor(QColor(39, 45, 56));
-			for (int i = left; i <= right; ++i)
-				if (i % interval != 0)
-				{
-					glVertex2d(i * gridSpacing, visibleRect.top());
-					glVertex2d(i * gridSpacing, visibleRect.bottom());
-				}
-
-			for (int i = top; i <= bottom; ++i)
-				if (i % interval != 0)
-				{
-					glVertex2d(visibleRect.left(), i * gridSpacing);
-					glVertex2d(visibleRect.right(), i * gridSpacing);
-				}
-
-			// рисуем основные линии
-			qglColor(QColor(51, 57, 73));
-			for (int i = left; i <= right; ++i)
-				if (i % interval == 0)
-				{
-					glVertex2d(i * gridSpacing, visibleRect.top());
-					glVertex2d(i * gridSpacing, visibleRect.bottom());
-				}
-
-			for (int i = top; i <= bottom; ++i)
-				if (i % interval == 0)
-				{
-					glVertex2d(visibleRect.left(), i * gridSpacing);
-					glVertex2d(visibleRect.right(), i * gridSpacing);
-				}
-
-			glEnd();
-		}
-		else
-		{
-			glBegin(GL_POINTS);
+	// устанавливаем стандартное смешивание цветов
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-			// рисуем вспомогательные точки
-			qglColor(QColor(51, 57, 73));
-			for (int i = left; i <= right; ++i)
-				for (int j = top; j <= bottom; ++j)
-					if (i % interval != 0 && j % interval != 0)
-						glVertex2d(i * gridSpacing, j * gridSpacing);
+	// рисуем сцену целиком или, при перетаскивании выделенных объектов, только их поверх кэша неподвижной части сцены
+	if (isDraggingSelection() && (isSelectionCacheValid() || createSelectionCache(visibleRect)))
+	{
+		// учитываем объекты, отброшенные при создании кэша, так как они отбрасываются и в каждом кадре из кэша
+		mSpriteBatch.resetNumCulledObjects(mSelectionCacheCulledObjects);
 
-			// рисуем основные точки
-			qglColor(QColor(77, 86, 110));
-			for (int i = left; i <= right; ++i)
-				for (int j = top; j <= bottom; ++j)
-					if (i % interval == 0 || j % interval == 0)
-						glVertex2d(i * gridSpacing, j * gridSpacing);
+		// рисуем фон и объекты под выделением из кэша
+		drawFramebuffer(mBelowSelectionBuffer, visibleRect, false);
 
-			glEnd();
-		}
+		// рисуем выделенные объекты и объекты между ними
+		drawGameObjects(mSelectionRangeObjects, visibleRect);
 
-		// рисуем оси координат
-		glBegin(GL_LINES);
-		qglColor(QColor(109, 36, 38));
-		glVertex2d(visibleRect.left(), 0.0);
-		glVertex2d(visibleRect.right(), 0.0);
-		qglColor(QColor(35, 110, 38));
-		glVertex2d(0.0, visibleRect.top());
-		glVertex2d(0.0, visibleRect.bottom());
-		glEnd();
-
-		// восстанавливаем матрицу трансформации
-		glPopMatrix();
+		// рисуем объекты над выделением из кэша, если он создан, и поверх них объекты, не попавшие в кэш
+		if (mAboveSelectionBuffer != NULL)
+			drawFramebuffer(mAboveSelectionBuffer, visibleRect, true);
+		drawGameObjects(mAboveSelectionObjects, visibleRect);
+	}
+	else
+	{
+		// удаляем кэш, оставшийся от перетаскивания
+		releaseSelectionCache();
+
+		// рисуем фон и всю сцену
+		mSpriteBatch.resetNumCulledObjects();
+		drawBackground(visibleRect);
+		glEnable(GL_TEXTURE_2D);
+		glEnable(GL_BLEND);
+		mScene->getRootLayer()->draw(mSpriteBatch, visibleRect);
+		mSpriteBatch.flush();
+		glDisable(GL_TEXTURE_2D);
+		glDisable(GL_BLEND);
 	}
-
-	// рисуем сцену
-	glEnable(GL_TEXTURE_2D);
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-	mScene->getRootLayer()->draw();
-	glDisable(GL_TEXTURE_2D);
-	glDisable(GL_BLEND);
 
 	// создаем painter для дополнительного рисования
 	QPainter painter(this);
+	Options &options = Options::getSingleton();
 
 	// рисуем прямоугольник выделения
 	if (!mSelectedObjects.empty())
@@ -823,6 +845,7 @@ void EditorWindow::mousePressEvent(QMouseEvent *event)
 		mFirstPos = event->pos();
 		mEditEnabled = false;
 		mHorzSnapLine = mVertSnapLine = QLineF();
+		mSnapIndex.clear();
 
 		bool showGuides = Options::getSingleton().isShowGuides();
 		qreal distance = GUIDE_DISTANCE / mZoom;
@@ -903,6 +926,9 @@ void EditorWindow::mousePressEvent(QMouseEvent *event)
 			mEditorState = STATE_SELECT;
 			mSelectionRect = QRectF(pos, pos);
 		}
+
+		// перерисовываем окно
+		invalidate();
 	}
 }
 
@@ -982,9 +1008,11 @@ void EditorWindow::mouseReleaseEvent(QMouseEvent *event)
 				mScene->removeGuide(mEditorState == STATE_HORZ_GUIDE, mGuideIndex);
 		}
 
-		// возвращаемся в состояние простоя
+		// возвращаемся в состояние простоя, удаляем индекс привязки и перерисовываем окно
 		mEditorState = STATE_IDLE;
+		mSnapIndex.clear();
 		updateMouseCursor(pos);
+		invalidate();
 	}
 }
 
@@ -1313,7 +1341,7 @@ void EditorWindow::mouseMoveEvent(QMouseEvent *event)
 				const qreal MAX_COORD = 1.0E+8;
 				qreal distance = SNAP_DISTANCE / mZoom;
 				mHorzSnapLine = mVertSnapLine = QLineF();
-				mScene->getRootLayer()->snapYCoord(pos.y(), MAX_COORD, -MAX_COORD, QList<GameObject *>(), snappedY, distance, mHorzSnapLine);
+				getSnapIndex().snapYCoord(pos.y(), MAX_COORD, -MAX_COORD, QSet<GameObject *>(), snappedY, distance, mHorzSnapLine);
 			}
 			mScene->setGuide(true, mGuideIndex, qRound(snappedY));
 		}
@@ -1326,7 +1354,7 @@ void EditorWindow::mouseMoveEvent(QMouseEvent *event)
 				const qreal MAX_COORD = 1.0E+8;
 				qreal distance = SNAP_DISTANCE / mZoom;
 				mHorzSnapLine = mVertSnapLine = QLineF();
-				mScene->getRootLayer()->snapXCoord(pos.x(), MAX_COORD, -MAX_COORD, QList<GameObject *>(), snappedX, distance, mVertSnapLine);
+				getSnapIndex().snapXCoord(pos.x(), MAX_COORD, -MAX_COORD, QSet<GameObject *>(), snappedX, distance, mVertSnapLine);
 			}
 			mScene->setGuide(false, mGuideIndex, qRound(snappedX));
 		}
@@ -1336,6 +1364,10 @@ void EditorWindow::mouseMoveEvent(QMouseEvent *event)
 			emit objectsChanged(mSelectedObjects, mSnappedCenter);
 	}
 
+	// перерисовываем окно при перемещении камеры или перетаскивании
+	if ((event->buttons() & Qt::RightButton) != 0 || (mEditEnabled && mEditorState != STATE_IDLE))
+		invalidate();
+
 	// обновляем курсор мыши
 	updateMouseCursor(pos);
 
@@ -1376,6 +1408,9 @@ void EditorWindow::wheelEvent(QWheelEvent *event)
 		updateMouseCursor(pos);
 		emit mouseMoved(pos);
 	}
+
+	// перерисовываем окно
+	invalidate();
 }
 
 void EditorWindow::keyPressEvent(QKeyEvent *event)
@@ -1529,6 +1564,20 @@ void EditorWindow::dropEvent(QDropEvent *event)
 	event->acceptProposedAction();
 }
 
+void EditorWindow::onSceneUndoCommandChanged()
+{
+	// сбрасываем кэш неподвижной части сцены и посылаем сигнал об изменении текущей команды
+	invalidateSelectionCache();
+	emit undoCommandChanged();
+
+	// посылаем сигналы об изменении слоев, содержимое которых было восстановлено
+	foreach (BaseLayer *layer, mScene->getRestoredLayers())
+		emit layerChanged(mScene, layer);
+
+	// перерисовываем окно
+	invalidate();
+}
+
 QPointF EditorWindow::worldToWindow(const QPointF &pt) const
 {
 	return (pt - mCameraPos) * mZoom;
@@ -1596,8 +1645,17 @@ qreal EditorWindow::snapXCoord(qreal x, qreal y1, qreal y2, bool excludeSelectio
 	// привязываем координату к умным направляющим
 	if (options.isEnableSmartGuides())
 	{
-		const QList<GameObject *> &excludedObjects = excludeSelection ? mSelectedObjects : QList<GameObject *>();
-		mScene->getRootLayer()->snapXCoord(x, y1, y2, excludedObjects, snappedX, distance, line);
+		if (mEditorState != STATE_IDLE)
+		{
+			// во время перетаскивания используем индекс краев объектов
+			const QSet<GameObject *> &excludedObjects = excludeSelection ? mSnapExcludedObjects : QSet<GameObject *>();
+			getSnapIndex().snapXCoord(x, y1, y2, excludedObjects, snappedX, distance, line);
+		}
+		else
+		{
+			const QList<GameObject *> &excludedObjects = excludeSelection ? mSelectedObjects : QList<GameObject *>();
+			mScene->getRootLayer()->snapXCoord(x, y1, y2, excludedObjects, snappedX, distance, line);
+		}
 	}
 
 	// привязываем координату к сетке
@@ -1648,8 +1706,17 @@ qreal EditorWindow::snapYCoord(qreal y, qreal x1, qreal x2, bool excludeSelectio
 	// привязываем координату к умным направляющим
 	if (options.isEnableSmartGuides())
 	{
-		const QList<GameObject *> &excludedObjects = excludeSelection ? mSelectedObjects : QList<GameObject *>();
-		mScene->getRootLayer()->snapYCoord(y, x1, x2, excludedObjects, snappedY, distance, line);
+		if (mEditorState != STATE_IDLE)
+		{
+			// во время перетаскивания используем индекс краев объектов
+			const QSet<GameObject *> &excludedObjects = excludeSelection ? mSnapExcludedObjects : QSet<GameObject *>();
+			getSnapIndex().snapYCoord(y, x1, x2, excludedObjects, snappedY, distance, line);
+		}
+		else
+		{
+			const QList<GameObject *> &excludedObjects = excludeSelection ? mSelectedObjects : QList<GameObject *>();
+			mScene->getRootLayer()->snapYCoord(y, x1, x2, excludedObjects, snappedY, distance, line);
+		}
 	}
 
 	// привязываем координату к сетке
@@ -1784,6 +1851,9 @@ void EditorWindow::selectGameObjects(const QList<GameObject *> &objects)
 		// посылаем сигнал об изменении выделения
 		emit selectionChanged(mSelectedObjects, mSnappedCenter);
 	}
+
+	// перерисовываем рамку выделения
+	invalidate();
 }
 
 void EditorWindow::sortSelectedGameObjects()
@@ -1899,6 +1969,9 @@ void EditorWindow::emitSceneAndLayerChangedSignals(const QSet<BaseLayer *> &laye
 	emit sceneChanged(commandName);
 	foreach (BaseLayer *layer, layers)
 		emit layerChanged(mScene, layer);
+
+	// перерисовываем окно
+	invalidate();
 }
 
 EditorWindow::SelectionMarker EditorWindow::findSelectionMarker(const QPointF &pos, qreal size) const
@@ -1959,3 +2032,272 @@ void EditorWindow::drawSnapLine(const QLineF &line, QPainter &painter)
 	painter.drawLine(QPointF(p2.x() - offset, p2.y() - offset), QPointF(p2.x() + offset, p2.y() + offset));
 	painter.drawLine(QPointF(p2.x() - offset, p2.y() + offset), QPointF(p2.x() + offset, p2.y() - offset));
 }
+
+bool EditorWindow::isDraggingSelection() const
+{
+	return (mEditorState == STATE_MOVE || mEditorState == STATE_RESIZE || mEditorState == STATE_ROTATE)
+		&& mEditEnabled && !mSelectedObjects.empty();
+}
+
+void EditorWindow::drawBackground(const QRectF &visibleRect)
+{
+	// очищаем окно
+	qglClearColor(QColor(33, 40, 48));
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	// рисуем сетку
+	Options &options = Options::getSingleton();
+	if (options.isShowGrid())
+	{
+		// подбираем подходящий шаг сетки
+		int gridSpacing = options.getGridSpacing();
+		while (gridSpacing * mZoom < MIN_GRID_SPACING)
+			gridSpacing *= GRID_SPACING_COEFF;
+
+		// определение номеров линий для отрисовки
+		int left = static_cast<int>(visibleRect.left() / gridSpacing);
+		int top = static_cast<int>(visibleRect.top() / gridSpacing);
+		int right = static_cast<int>(visibleRect.right() / gridSpacing);
+		int bottom = static_cast<int>(visibleRect.bottom() / gridSpacing);
+
+		// устанавливаем сдвиг в 0.5 пикселя
+		glPushMatrix();
+		glTranslated(0.5 / mZoom, 0.5 / mZoom, 0.0);
+
+		// рисуем сетку из линий или точек
+		int interval = options.getMajorLinesInterval();
+		if (!options.isShowDots())
+		{
+			glBegin(GL_LINES);
+
+			// рисуем вспомогательные линии
+			qglColor(QColor(39, 45, 56));
+			for (int i = left; i <= right; ++i)
+				if (i % interval != 0)
+				{
+					glVertex2d(i * gridSpacing, visibleRect.top());
+					glVertex2d(i * gridSpacing, visibleRect.bottom());
+				}
+
+			for (int i = top; i <= bottom; ++i)
+				if (i % interval != 0)
+				{
+					glVertex2d(visibleRect.left(), i * gridSpacing);
+					glVertex2d(visibleRect.right(), i * gridSpacing);
+				}
+
+			// рисуем основные линии
+			qglColor(QColor(51, 57, 73));
+			for (int i = left; i <= right; ++i)
+				if (i % interval == 0)
+				{
+					glVertex2d(i * gridSpacing, visibleRect.top());
+					glVertex2d(i * gridSpacing, visibleRect.bottom());
+				}
+
+			for (int i = top; i <= bottom; ++i)
+				if (i % interval == 0)
+				{
+					glVertex2d(visibleRect.left(), i * gridSpacing);
+					glVertex2d(visibleRect.right(), i * gridSpacing);
+				}
+
+			glEnd();
+		}
+		else
+		{
+			glBegin(GL_POINTS);
+
+			// рисуем вспомогательные точки
+			qglColor(QColor(51, 57, 73));
+			for (int i = left; i <= right; ++i)
+				for (int j = top; j <= bottom; ++j)
+					if (i % interval != 0 && j % interval != 0)
+						glVertex2d(i * gridSpacing, j * gridSpacing);
+
+			// рисуем основные точки
+			qglColor(QColor(77, 86, 110));
+			for (int i = left; i <= right; ++i)
+				for (int j = top; j <= bottom; ++j)
+					if (i % interval == 0 || j % interval == 0)
+						glVertex2d(i * gridSpacing, j * gridSpacing);
+
+			glEnd();
+		}
+
+		// рисуем оси координат
+		glBegin(GL_LINES);
+		qglColor(QColor(109, 36, 38));
+		glVertex2d(visibleRect.left(), 0.0);
+		glVertex2d(visibleRect.right(), 0.0);
+		qglColor(QColor(35, 110, 38));
+		glVertex2d(0.0, visibleRect.top());
+		glVertex2d(0.0, visibleRect.bottom());
+		glEnd();
+
+		// восстанавливаем матрицу трансформации
+		glPopMatrix();
+	}
+}
+
+void EditorWindow::drawGameObjects(const QList<GameObject *> &objects, const QRectF &visibleRect)
+{
+	glEnable(GL_TEXTURE_2D);
+	glEnable(GL_BLEND);
+
+	// отрисовываем объекты от нижнего к верхнему, отбрасывая не попадающие в видимую область
+	int numCulledObjects = 0;
+	for (int i = objects.size() - 1; i >= 0; --i)
+	{
+		if (visibleRect.intersects(objects[i]->getDrawingRect()))
+			objects[i]->draw(mSpriteBatch);
+		else
+			++numCulledObjects;
+	}
+
+	mSpriteBatch.flush();
+	mSpriteBatch.addCulledObjects(numCulledObjects);
+
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_BLEND);
+}
+
+void EditorWindow::drawFramebuffer(QGLFramebufferObject *buffer, const QRectF &visibleRect, bool premultipliedAlpha)
+{
+	// содержимое кэша с прозрачным фоном смешиваем с уже умноженными на альфу цветами
+	glEnable(GL_TEXTURE_2D);
+	if (premultipliedAlpha)
+	{
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	}
+
+	// рисуем текстуру кадрового буфера на всю видимую область (изображение в текстуре перевернуто по вертикали)
+	glBindTexture(GL_TEXTURE_2D, buffer->texture());
+	glColor4ub(255, 255, 255, 255);
+	glBegin(GL_QUADS);
+	glTexCoord2f(0.0f, 1.0f);
+	glVertex2d(visibleRect.left(), visibleRect.top());
+	glTexCoord2f(0.0f, 0.0f);
+	glVertex2d(visibleRect.left(), visibleRect.bottom());
+	glTexCoord2f(1.0f, 0.0f);
+	glVertex2d(visibleRect.right(), visibleRect.bottom());
+	glTexCoord2f(1.0f, 1.0f);
+	glVertex2d(visibleRect.right(), visibleRect.top());
+	glEnd();
+
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+}
+
+bool EditorWindow::isSelectionCacheValid() const
+{
+	return mSelectionCacheValid && mSelectionCacheCameraPos == mCameraPos && mSelectionCacheZoom == mZoom && mSelectionCacheSize == size();
+}
+
+bool EditorWindow::createSelectionCache(const QRectF &visibleRect)
+{
+	// удаляем устаревший кэш
+	releaseSelectionCache();
+
+	// проверяем поддержку кадровых буферов
+	if (!QGLFramebufferObject::hasOpenGLFramebufferObjects())
+		return false;
+
+	// получаем список видимых объектов от верхнего к нижнему и находим в нем крайние выделенные объекты
+	QList<GameObject *> objects = mScene->getRootLayer()->findVisibleGameObjects();
+	QSet<GameObject *> selectedObjects = mSelectedObjects.toSet();
+	int first = -1, last = -1;
+	for (int i = 0; i < objects.size(); ++i)
+		if (selectedObjects.contains(objects[i]))
+		{
+			if (first == -1)
+				first = i;
+			last = i;
+		}
+
+	// выходим, если выделенные объекты не найдены среди видимых
+	if (first == -1)
+		return false;
+
+	// разбиваем список на объекты над выделением, между выделенными объектами и под выделением
+	QList<GameObject *> aboveObjects = objects.mid(0, first);
+	QList<GameObject *> belowObjects = objects.mid(last + 1);
+	mSelectionRangeObjects = objects.mid(first, last - first + 1);
+
+	// рисуем фон и объекты под выделением в кадровый буфер, считая отброшенные объекты с нуля
+	mSpriteBatch.resetNumCulledObjects();
+	mBelowSelectionBuffer = new QGLFramebufferObject(size());
+	mBelowSelectionBuffer->bind();
+	drawBackground(visibleRect);
+	drawGameObjects(belowObjects, visibleRect);
+	mBelowSelectionBuffer->release();
+
+	// получаем функцию раздельного смешивания цвета и альфы
+	if (mBlendFuncSeparate == NULL)
+		mBlendFuncSeparate = reinterpret_cast<BlendFuncSeparateProc>(context()->getProcAddress("glBlendFuncSeparate"));
+
+	// FTGL рисует текст со своей функцией смешивания, которая портит альфа-канал буфера, поэтому
+	// нижнюю надпись над выделением и все объекты над ней рисуем напрямую, а кэшируем только объекты под ней
+	int lastLabel = -1;
+	for (int i = 0; i < aboveObjects.size(); ++i)
+		if (dynamic_cast<Label *>(aboveObjects[i]) != NULL)
+			lastLabel = i;
+	mAboveSelectionObjects = aboveObjects.mid(0, lastLabel + 1);
+	aboveObjects = aboveObjects.mid(lastLabel + 1);
+
+	// рисуем объекты над выделением в кадровый буфер с прозрачным фоном и premultiplied alpha,
+	// без раздельного смешивания альфа-канал буфера получается неверным, поэтому такие объекты рисуем напрямую
+	if (!aboveObjects.empty() && mBlendFuncSeparate != NULL)
+	{
+		mAboveSelectionBuffer = new QGLFramebufferObject(size());
+		mAboveSelectionBuffer->bind();
+		glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+		glClear(GL_COLOR_BUFFER_BIT);
+		mBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+		drawGameObjects(aboveObjects, visibleRect);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		mAboveSelectionBuffer->release();
+	}
+	else
+	{
+		mAboveSelectionObjects += aboveObjects;
+	}
+
+	// запоминаем параметры камеры и окна, для которых создан кэш, и количество отброшенных при этом объектов
+	mSelectionCacheCulledObjects = mSpriteBatch.getNumCulledObjects();
+	mSelectionCacheValid = true;
+	mSelectionCacheCameraPos = mCameraPos;
+	mSelectionCacheZoom = mZoom;
+	mSelectionCacheSize = size();
+	return true;
+}
+
+void EditorWindow::invalidateSelectionCache()
+{
+	mSelectionCacheValid = false;
+}
+
+void EditorWindow::releaseSelectionCache()
+{
+	// удаляем кадровые буферы и списки объектов
+	delete mBelowSelectionBuffer;
+	mBelowSelectionBuffer = NULL;
+	delete mAboveSelectionBuffer;
+	mAboveSelectionBuffer = NULL;
+	mSelectionRangeObjects.clear();
+	mAboveSelectionObjects.clear();
+	mSelectionCacheValid = false;
+}
+
+const SnapIndex &EditorWindow::getSnapIndex()
+{
+	// строим индекс по активным объектам сцены, запоминая выделенные объекты для исключения из привязки
+	if (!mSnapIndex.isBuilt())
+	{
+		mSnapIndex.build(mScene->getRootLayer()->findActiveGameObjects());
+		mSnapExcludedObjects = mSelectedObjects.toSet();
+	}
+	return mSnapIndex;
+}
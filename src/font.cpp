@@ -2,16 +2,10 @@
 #include "font.h"
 #include "utils.h"
 
-Font::Font()
-: mFont(NULL), mDefault(true)
+Font::Font(const QSharedPointer<FontFile> &file, int size, bool defaultFont)
+: mFont(NULL), mFile(file), mHeight(0.0), mDefault(defaultFont)
 {
-	load(":/default_font.ttf", 32);
-}
-
-Font::Font(const QString &fileName, int size)
-: mFont(NULL), mDefault(false)
-{
-	load(fileName, size);
+	load(size);
 }
 
 Font::~Font()
@@ -44,30 +38,25 @@ void Font::draw(const QString &text)
 	mFont->Render(Utils::toStdWString(text).c_str());
 }
 
-void Font::load(const QString &fileName, int size)
+void Font::draw(const std::wstring &text)
+{
+	mFont->Render(text.c_str());
+}
+
+void Font::load(int size)
 {
-	// загружаем файл шрифта в буфер
-	QFile file(fileName);
-	file.open(QIODevice::ReadOnly);
-	mFontBuffer = file.readAll();
-	if (mFontBuffer.isEmpty())
+	// выходим, если файл шрифта не загружен
+	if (!mFile->isLoaded())
 		return;
 
-	// создаем и настраиваем шрифт
-	mFont = new FTTextureFont(reinterpret_cast<unsigned char *>(mFontBuffer.data()), mFontBuffer.size());
+	// создаем и настраиваем шрифт из данных разделяемого файла без повторного чтения с диска
+	mFont = new FTTextureFont(mFile->getData(), mFile->getSize());
 	if (mFont->Error() != 0)
 		return;
 	mFont->GlyphLoadFlags(FT_LOAD_DEFAULT);
 	mFont->FaceSize(size);
 	mFont->CharMap(FT_ENCODING_UNICODE);
 
-	// используем FreeType для получения правильной высоты шрифта, т.к. FTGL использует свои формулы на основе баундинг ректа
-	FT_Library library;
-	FT_Face face;
-	FT_Init_FreeType(&library);
-	FT_New_Memory_Face(library, reinterpret_cast<unsigned char *>(mFontBuffer.data()), mFontBuffer.size(), 0, &face);
-	FT_Set_Char_Size(face, 0, size * 64, 72, 72);
-	mHeight = face->size->metrics.height / 64.0;
-	FT_Done_Face(face);
-	FT_Done_FreeType(library);
+	// получаем высоту шрифта от разделяемой гарнитуры FreeType
+	mHeight = mFile->getHeight(size);
 }
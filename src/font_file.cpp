@@ -0,0 +1,53 @@
+#include "pch.h"
+#include "font_file.h"
+
+FontFile::FontFile(const QString &fileName, const QSharedPointer<FT_LibraryRec_> &library)
+: mLibrary(library), mFileName(fileName), mData(NULL), mSize(0), mFace(NULL)
+{
+	// читаем файл шрифта в буфер: отображение в память привело бы к падению при усечении файла на диске
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+		return;
+	mBuffer = file.readAll();
+	if (mBuffer.isEmpty())
+		return;
+	mData = reinterpret_cast<const uchar *>(mBuffer.constData());
+	mSize = mBuffer.size();
+
+	// создаем гарнитуру FreeType из данных файла
+	if (FT_New_Memory_Face(mLibrary.data(), mData, mSize, 0, &mFace) != 0)
+		mFace = NULL;
+}
+
+FontFile::~FontFile()
+{
+	if (mFace != NULL)
+		FT_Done_Face(mFace);
+}
+
+bool FontFile::isLoaded() const
+{
+	return mFace != NULL;
+}
+
+QString FontFile::getFileName() const
+{
+	return mFileName;
+}
+
+const uchar *FontFile::getData() const
+{
+	return mData;
+}
+
+qint64 FontFile::getSize() const
+{
+	return mSize;
+}
+
+qreal FontFile::getHeight(int size)
+{
+	// используем FreeType для получения правильной высоты шрифта, т.к. FTGL использует свои формулы на основе баундинг ректа
+	FT_Set_Char_Size(mFace, 0, size * 64, 72, 72);
+	return mFace->size->metrics.height / 64.0;
+}
@@ -1,42 +1,84 @@
 #include "pch.h"
 #include "font_manager.h"
+#include "options.h"
 #include "project.h"
 #include "utils.h"
 
 template<> FontManager *Singleton<FontManager>::mSingleton = NULL;
 
 FontManager::FontManager(QGLWidget *primaryGLWidget)
-: mPrimaryGLWidget(primaryGLWidget)
+: mPrimaryGLWidget(primaryGLWidget), mNumHits(0), mNumMisses(0), mNumEvictions(0)
 {
+	// инициализируем общую библиотеку FreeType
+	FT_Library library;
+	if (FT_Init_FreeType(&library) == 0)
+		mLibrary = QSharedPointer<FT_LibraryRec_>(library, FT_Done_FreeType);
+
+	// создаем объект слежения за загруженными файлами шрифтов
+	mWatcher = new QFileSystemWatcher(this);
+	connect(mWatcher, SIGNAL(fileChanged(const QString &)), this, SLOT(onFontFileChanged(const QString &)));
+
+	// запускаем таймер удаления устаревших неиспользуемых шрифтов
+	startTimer(1000);
+}
+
+FontManager::~FontManager()
+{
+	// удаляем неиспользуемые шрифты; используемые шрифты будут удалены при освобождении
+	mPrimaryGLWidget->makeCurrent();
+	foreach (const FontKey &key, mUnusedFonts)
+		delete mFontCache[key].mUnusedFont;
 }
 
 QSharedPointer<Font> FontManager::loadFont(const QString &fileName, int size, bool useDefaultFont)
 {
 	// сначала ищем шрифт в кэше
-	for (FontCache::iterator it = mFontCache.begin(); it != mFontCache.end(); ++it)
-		if (it->mFileName == fileName && it->mSize == size)
+	FontKey key(fileName, size);
+	FontCache::iterator it = mFontCache.find(key);
+	if (it != mFontCache.end())
+	{
+		// возвращаем используемый шрифт
+		QSharedPointer<Font> font = it->mFont.toStrongRef();
+		if (!font.isNull())
 		{
-			QSharedPointer<Font> font = it->mFont.toStrongRef();
-			if (!font.isNull())
-				return font;
-			mFontCache.erase(it);
-			break;
+			++mNumHits;
+			return font;
 		}
 
-	// не нашли в кэше - загружаем шрифт из файла
+		// возвращаем в использование неиспользуемый шрифт
+		if (it->mUnusedFont != NULL)
+		{
+			font = QSharedPointer<Font>(it->mUnusedFont, releaseFont);
+			it->mFont = font;
+			it->mUnusedFont = NULL;
+			mUnusedFonts.removeOne(key);
+			++mNumHits;
+			return font;
+		}
+	}
+	++mNumMisses;
+
+	// не нашли в кэше - ищем файл шрифта, обращаясь к диску, только если он еще не загружен
 	QSharedPointer<Font> font;
 	QString path = Project::getSingleton().getRootDirectory() + fileName;
+	QSharedPointer<FontFile> file = mFontFileCache.value(path).toStrongRef();
+	if (file.isNull() && Utils::fileExists(path))
+		file = loadFontFile(path);
+
+	// создаем шрифт нужного размера из файла
 	mPrimaryGLWidget->makeCurrent();
-	if (Utils::fileExists(path) && (font = QSharedPointer<Font>(new Font(path, size)))->isLoaded())
+	if (!file.isNull() && (font = QSharedPointer<Font>(new Font(file, size), releaseFont))->isLoaded())
 	{
 		// добавляем шрифт в кэш
-		mFontCache.push_back(FontInfo(fileName, size, font));
+		mFontCache[key].mFont = font;
+		mFontKeys.insert(font.data(), key);
 	}
 	else if (useDefaultFont)
 	{
 		// возвращаем шрифт по умолчанию
-		font = QSharedPointer<Font>(new Font());
-		mFontCache.push_back(FontInfo(fileName, size, font));
+		font = QSharedPointer<Font>(new Font(loadFontFile(":/default_font.ttf"), 32, true), releaseFont);
+		mFontCache[key].mFont = font;
+		mFontKeys.insert(font.data(), key);
 	}
 	else
 	{
@@ -51,3 +93,134 @@ void FontManager::makeCurrent()
 {
 	mPrimaryGLWidget->makeCurrent();
 }
+
+int FontManager::getNumHits() const
+{
+	return mNumHits;
+}
+
+int FontManager::getNumMisses() const
+{
+	return mNumMisses;
+}
+
+int FontManager::getNumEvictions() const
+{
+	return mNumEvictions;
+}
+
+void FontManager::timerEvent(QTimerEvent *event)
+{
+	// удаляем неиспользуемые шрифты, время хранения которых истекло
+	int timeout = Options::getSingleton().getFontCacheTimeout();
+	if (timeout > 0)
+		while (!mUnusedFonts.empty() && mFontCache[mUnusedFonts.front()].mTimer.hasExpired(timeout * 1000))
+			evictFont();
+}
+
+QSharedPointer<FontFile> FontManager::loadFontFile(const QString &path)
+{
+	// ищем файл в кэше
+	QSharedPointer<FontFile> file = mFontFileCache.value(path).toStrongRef();
+	if (!file.isNull())
+		return file;
+
+	// загружаем файл и добавляем его в кэш, ставя файлы на диске на слежение
+	file = QSharedPointer<FontFile>(new FontFile(path, mLibrary), releaseFontFile);
+	if (file->isLoaded())
+	{
+		mFontFileCache.insert(path, file);
+		if (!path.startsWith(":"))
+			mWatcher->addPath(path);
+	}
+	return file;
+}
+
+void FontManager::onFontFileChanged(const QString &path)
+{
+	// забываем устаревший файл; используемые шрифты сохраняют свою копию данных до освобождения
+	mFontFileCache.remove(path);
+	mWatcher->removePath(path);
+
+	// удаляем из кэша шрифты этого файла, чтобы при следующем запросе они были загружены заново
+	QString rootDirectory = Project::getSingleton().getRootDirectory();
+	FontCache::iterator it = mFontCache.begin();
+	while (it != mFontCache.end())
+	{
+		if (rootDirectory + it.key().first != path)
+		{
+			++it;
+			continue;
+		}
+
+		// используемый шрифт будет удален при освобождении, а неиспользуемый удаляем сразу
+		mFontKeys.remove(it->mUnusedFont != NULL ? it->mUnusedFont : it->mFont.data());
+		if (it->mUnusedFont != NULL)
+		{
+			mUnusedFonts.removeOne(it.key());
+			mPrimaryGLWidget->makeCurrent();
+			delete it->mUnusedFont;
+		}
+		it = mFontCache.erase(it);
+	}
+}
+
+void FontManager::releaseFont(Font *font)
+{
+	// удаляем шрифт, если он создан не через кэш, его файл изменился или менеджер шрифтов уже удален
+	FontManager *manager = getSingletonPtr();
+	if (manager == NULL)
+	{
+		delete font;
+	}
+	else if (!manager->mFontKeys.contains(font))
+	{
+		manager->makeCurrent();
+		delete font;
+	}
+	else
+	{
+		manager->retainFont(font);
+	}
+}
+
+void FontManager::releaseFontFile(FontFile *file)
+{
+	// удаляем запись кэша, ссылка которой устарела, чтобы кэш не рос за счет уже освобожденных файлов
+	FontManager *manager = getSingletonPtr();
+	if (manager != NULL)
+	{
+		FontFileCache::iterator it = manager->mFontFileCache.find(file->getFileName());
+		if (it != manager->mFontFileCache.end() && it->isNull())
+		{
+			manager->mFontFileCache.erase(it);
+			manager->mWatcher->removePath(file->getFileName());
+		}
+	}
+	delete file;
+}
+
+void FontManager::retainFont(Font *font)
+{
+	// помещаем шрифт в конец списка неиспользуемых шрифтов
+	FontKey key = mFontKeys.value(font);
+	FontInfo &info = mFontCache[key];
+	info.mUnusedFont = font;
+	info.mTimer.start();
+	mUnusedFonts.push_back(key);
+
+	// удаляем самые давно освобожденные шрифты сверх допустимого количества
+	int cacheSize = Options::getSingleton().getFontCacheSize();
+	while (mUnusedFonts.size() > cacheSize)
+		evictFont();
+}
+
+void FontManager::evictFont()
+{
+	// удаляем шрифт вместе с записью в кэше
+	FontInfo info = mFontCache.take(mUnusedFonts.takeFirst());
+	mFontKeys.remove(info.mUnusedFont);
+	mPrimaryGLWidget->makeCurrent();
+	delete info.mUnusedFont;
+	++mNumEvictions;
+}
@@ -6,12 +6,13 @@
 #include "utils.h"
 
 GameObject::GameObject()
-: mParentLayer(NULL)
+: mParentLayer(NULL), mUndoKey(0), mUndoDirty(true), mLanguageVersion(-1)
 {
 }
 
 GameObject::GameObject(const QString &name, int id, Layer *parent)
-: mName(name), mObjectID(id), mRotationAngle(0.0), mRotationCenter(0.5, 0.5), mParentLayer(NULL)
+: mName(name), mObjectID(id), mRotationAngle(0.0), mRotationCenter(0.5, 0.5), mParentLayer(NULL), mUndoKey(0), mUndoDirty(true),
+  mLanguageVersion(Project::getSingleton().getLanguageVersion())
 {
 	// добавляем себя в родительский слой
 	if (parent != NULL)
@@ -20,8 +21,8 @@ GameObject::GameObject(const QString &name, int id, Layer *parent)
 
 GameObject::GameObject(const GameObject &object)
 : mName(object.mName), mObjectID(object.mObjectID), mPosition(object.mPosition), mSize(object.mSize),
-  mRotationAngle(object.mRotationAngle), mRotationCenter(object.mRotationCenter), mParentLayer(NULL),
-  mPositionXMap(object.mPositionXMap), mPositionYMap(object.mPositionYMap),
+  mRotationAngle(object.mRotationAngle), mRotationCenter(object.mRotationCenter), mParentLayer(NULL), mUndoKey(0), mUndoDirty(true),
+  mLanguageVersion(object.mLanguageVersion), mPositionXMap(object.mPositionXMap), mPositionYMap(object.mPositionYMap),
   mWidthMap(object.mWidthMap), mHeightMap(object.mHeightMap)
 {
 	// обновляем текущую трансформацию
@@ -42,7 +43,13 @@ QString GameObject::getName() const
 
 void GameObject::setName(const QString &name)
 {
+	QString oldName = mName;
 	mName = name;
+	mUndoDirty = true;
+
+	// обновляем индекс имен родительского слоя
+	if (mParentLayer != NULL)
+		mParentLayer->updateNameIndex(this, oldName);
 }
 
 int GameObject::getObjectID() const
@@ -53,6 +60,7 @@ int GameObject::getObjectID() const
 void GameObject::setObjectID(int id)
 {
 	mObjectID = id;
+	mUndoDirty = true;
 }
 
 QPointF GameObject::getPosition() const
@@ -68,9 +76,10 @@ void GameObject::setPosition(const QPointF &position)
 	updateTransform();
 
 	// записываем локализованные координаты для текущего языка
-	QString language = Project::getSingleton().getCurrentLanguage();
+	int language = Project::getSingleton().getCurrentLanguageId();
 	mPositionXMap[language] = mPosition.x();
 	mPositionYMap[language] = mPosition.y();
+	mUndoDirty = true;
 }
 
 QSizeF GameObject::getSize() const
@@ -86,9 +95,10 @@ void GameObject::setSize(const QSizeF &size)
 	updateTransform();
 
 	// записываем локализованные размеры для текущего языка
-	QString language = Project::getSingleton().getCurrentLanguage();
+	int language = Project::getSingleton().getCurrentLanguageId();
 	mWidthMap[language] = mSize.width();
 	mHeightMap[language] = mSize.height();
+	mUndoDirty = true;
 }
 
 qreal GameObject::getRotationAngle() const
@@ -99,6 +109,7 @@ qreal GameObject::getRotationAngle() const
 void GameObject::setRotationAngle(qreal angle)
 {
 	mRotationAngle = angle;
+	mUndoDirty = true;
 	updateTransform();
 }
 
@@ -112,11 +123,13 @@ void GameObject::setRotationCenter(const QPointF &center)
 {
 	QPointF pt = worldToLocal(center);
 	mRotationCenter = QPointF(pt.x() / mSize.width(), pt.y() / mSize.height());
+	mUndoDirty = true;
 }
 
 void GameObject::resetRotationCenter()
 {
 	mRotationCenter = QPointF(0.5, 0.5);
+	mUndoDirty = true;
 }
 
 Layer *GameObject::getParentLayer() const
@@ -129,11 +142,36 @@ void GameObject::setParentLayer(Layer *parent)
 	mParentLayer = parent;
 }
 
+quint32 GameObject::getUndoKey() const
+{
+	return mUndoKey;
+}
+
+void GameObject::setUndoKey(quint32 key)
+{
+	mUndoKey = key;
+}
+
+bool GameObject::isUndoDirty() const
+{
+	return mUndoDirty;
+}
+
+void GameObject::setUndoDirty(bool dirty)
+{
+	mUndoDirty = dirty;
+}
+
 QRectF GameObject::getBoundingRect() const
 {
 	return mBoundingRect;
 }
 
+QRectF GameObject::getDrawingRect() const
+{
+	return mBoundingRect;
+}
+
 bool GameObject::isContainPoint(const QPointF &pt) const
 {
 	// проверяем, что локальные координаты точки лежат внутри исходного прямоугольника объекта (0, 0, w, h)
@@ -205,7 +243,12 @@ void GameObject::snapYCoord(qreal y, qreal x1, qreal x2, qreal &snappedY, qreal
 bool GameObject::load(QDataStream &stream)
 {
 	// загружаем свойства объекта из потока
+	QString oldName = mName;
 	stream >> mName >> mObjectID >> mPositionXMap >> mPositionYMap >> mWidthMap >> mHeightMap >> mRotationAngle >> mRotationCenter;
+
+	// обновляем индекс имен родительского слоя, так как объект может загружаться уже добавленным в слой
+	if (mParentLayer != NULL)
+		mParentLayer->updateNameIndex(this, oldName);
 	return stream.status() == QDataStream::Ok;
 }
 
@@ -218,14 +261,19 @@ bool GameObject::save(QDataStream &stream)
 
 bool GameObject::load(LuaScript &script)
 {
-	// загружаем свойства объекта из Lua скрипта
-	if (!script.getString("name", mName) || !script.getInt("id", mObjectID)
-		|| !readRealMap(script, "posX", mPositionXMap) || !readRealMap(script, "posY", mPositionYMap)
-		|| !readRealMap(script, "width", mWidthMap) || !readRealMap(script, "height", mHeightMap)
-		|| !script.getReal("angle", mRotationAngle)
-		|| !script.getReal("centerX", mRotationCenter.rx()) || !script.getReal("centerY", mRotationCenter.ry()))
-		return false;
-	return true;
+	return loadProperties(script, NUM_PROPERTIES);
+}
+
+void GameObject::registerPropertyKeys(LuaScript &script)
+{
+	// имена ключей в порядке перечисления PropertyKey
+	static const char *const names[NUM_PROPERTY_KEYS] =
+	{
+		"name", "id", "posX", "posY", "width", "height", "angle", "centerX", "centerY",
+		"fileName", "textureWidth", "textureHeight", "color",
+		"text", "size", "horzAlignment", "vertAlignment", "lineSpacing"
+	};
+	script.registerKeys(names, NUM_PROPERTY_KEYS);
 }
 
 bool GameObject::save(QTextStream &stream, int indent)
@@ -240,31 +288,47 @@ bool GameObject::save(QTextStream &stream, int indent)
 	writeRealMap(stream, mWidthMap);
 	stream << ", height = ";
 	writeRealMap(stream, mHeightMap);
-	stream << ", angle = " << mRotationAngle << ", centerX = " << mRotationCenter.x() << ", centerY = " << mRotationCenter.y();
+	stream << ", angle = ";
+	Utils::writeReal(stream, mRotationAngle);
+	stream << ", centerX = ";
+	Utils::writeReal(stream, mRotationCenter.x());
+	stream << ", centerY = ";
+	Utils::writeReal(stream, mRotationCenter.y());
 	return stream.status() == QTextStream::Ok;
 }
 
-void GameObject::setCurrentLanguage(const QString &language)
+void GameObject::setCurrentLanguage(int language)
 {
 	// устанавливаем новые значения позиции и размера для текущего языка
-	QString currentLanguage = isLocalized() ? language : Project::getSingleton().getDefaultLanguage();
+	int currentLanguage = isLocalized() ? language : Project::getSingleton().getDefaultLanguageId();
 	mPosition = QPointF(mPositionXMap[currentLanguage], mPositionYMap[currentLanguage]);
 	mSize = QSizeF(mWidthMap[currentLanguage], mHeightMap[currentLanguage]);
+	mLanguageVersion = Project::getSingleton().getLanguageVersion();
 
 	// обновляем текущую трансформацию
 	updateTransform();
 }
 
+bool GameObject::updateCurrentLanguage()
+{
+	// выходим, если значения локализованных свойств уже установлены для текущего языка
+	if (mLanguageVersion == Project::getSingleton().getLanguageVersion())
+		return false;
+
+	setCurrentLanguage(Project::getSingleton().getCurrentLanguageId());
+	return true;
+}
+
 bool GameObject::isLocalized() const
 {
-	QString language = Project::getSingleton().getCurrentLanguage();
+	int language = Project::getSingleton().getCurrentLanguageId();
 	return mPositionXMap.contains(language) && mPositionYMap.contains(language) && mWidthMap.contains(language) && mHeightMap.contains(language);
 }
 
 void GameObject::setLocalized(bool localized)
 {
-	QString currentLanguage = Project::getSingleton().getCurrentLanguage();
-	QString defaultLanguage = Project::getSingleton().getDefaultLanguage();
+	int currentLanguage = Project::getSingleton().getCurrentLanguageId();
+	int defaultLanguage = Project::getSingleton().getDefaultLanguageId();
 	Q_ASSERT(currentLanguage != defaultLanguage);
 
 	if (localized)
@@ -283,6 +347,8 @@ void GameObject::setLocalized(bool localized)
 		mWidthMap.remove(currentLanguage);
 		mHeightMap.remove(currentLanguage);
 	}
+
+	mUndoDirty = true;
 }
 
 void GameObject::loadTranslations(LuaScript *script)
@@ -322,23 +388,99 @@ void GameObject::updateTransform()
 		mBoundingRect.setRight(qMax(mBoundingRect.right(), mVertices[i].x()));
 		mBoundingRect.setBottom(qMax(mBoundingRect.bottom(), mVertices[i].y()));
 	}
+
+	// обновляем пространственный индекс и сбрасываем ограничивающий прямоугольник родительского слоя
+	if (mParentLayer != NULL)
+	{
+		mParentLayer->updateSpatialIndex(this);
+		mParentLayer->invalidateBoundingRect();
+	}
 }
 
-bool GameObject::readRealMap(LuaScript &script, const QString &name, RealMap &map)
+bool GameObject::loadProperties(LuaScript &script, int numProperties)
+{
+	// загружаем свойства по ключам элементов таблицы, пропуская неизвестные ключи
+	int numLoadedProperties = 0;
+	script.firstEntry();
+	while (script.nextEntry())
+		if (!loadProperty(script, script.getEntryKey(), numLoadedProperties))
+			return false;
+
+	// ключи таблицы уникальны, поэтому совпадение количества означает наличие всех обязательных свойств
+	return numLoadedProperties == numProperties;
+}
+
+bool GameObject::loadProperty(LuaScript &script, int key, int &numProperties)
+{
+	QString oldName;
+	bool result;
+	switch (key)
+	{
+	case KEY_NAME:
+		oldName = mName;
+		result = script.getString(mName);
+		if (mParentLayer != NULL)
+			mParentLayer->updateNameIndex(this, oldName);
+		break;
+
+	case KEY_ID:
+		result = script.getInt(mObjectID);
+		break;
+
+	case KEY_POS_X:
+		result = readRealMap(script, mPositionXMap);
+		break;
+
+	case KEY_POS_Y:
+		result = readRealMap(script, mPositionYMap);
+		break;
+
+	case KEY_WIDTH:
+		result = readRealMap(script, mWidthMap);
+		break;
+
+	case KEY_HEIGHT:
+		result = readRealMap(script, mHeightMap);
+		break;
+
+	case KEY_ANGLE:
+		result = script.getReal(mRotationAngle);
+		break;
+
+	case KEY_CENTER_X:
+		result = script.getReal(mRotationCenter.rx());
+		break;
+
+	case KEY_CENTER_Y:
+		result = script.getReal(mRotationCenter.ry());
+		break;
+
+	default:
+		// пропускаем значения неизвестных ключей
+		script.popValue();
+		return true;
+	}
+
+	++numProperties;
+	return result;
+}
+
+bool GameObject::readRealMap(LuaScript &script, RealMap &map)
 {
 	// очищаем список локализации
 	map.clear();
 
 	// пробуем получить одиночное значение
 	qreal value;
-	if (script.getReal(name, value))
+	if (script.getReal(value, false))
 	{
-		map[Project::getSingleton().getDefaultLanguage()] = value;
+		script.popValue();
+		map.insert(Project::getSingleton().getDefaultLanguageId(), value);
 		return true;
 	}
 
 	// пробуем получить таблицу с локализованными значениями
-	if (script.pushTable(name))
+	if (script.pushTable())
 	{
 		// получаем все элементы таблицы
 		script.firstEntry();
@@ -347,14 +489,14 @@ bool GameObject::readRealMap(LuaScript &script, const QString &name, RealMap &ma
 			QString key;
 			if (!script.getReal(value) || !script.getString(key, false))
 				return false;
-			map[key] = value;
+			map.insert(Project::getSingleton().getLanguageId(key), value);
 		}
 
 		// извлекаем таблицу из стека
 		script.popTable();
 
 		// проверяем, что в списке есть язык по умолчанию
-		return map.contains(Project::getSingleton().getDefaultLanguage());
+		return map.contains(Project::getSingleton().getDefaultLanguageId());
 	}
 
 	return false;
@@ -363,37 +505,43 @@ bool GameObject::readRealMap(LuaScript &script, const QString &name, RealMap &ma
 void GameObject::writeRealMap(QTextStream &stream, const RealMap &map)
 {
 	// записываем значение свойства
-	Q_ASSERT(!map.empty());
+	Q_ASSERT(!map.isEmpty());
 	if (map.size() > 1)
 	{
-		// записываем таблицу
+		// записываем таблицу, упорядочивая языки по кодам
+		QMap<QString, int> languages = map.getLanguagesByCode();
 		stream << "{";
-		for (RealMap::const_iterator it = map.begin(); it != map.end(); ++it)
-			stream << "[" << Utils::quotify(it.key()) << "] = " << *it << (it != --map.end() ? ", " : "");
+		for (QMap<QString, int>::const_iterator it = languages.begin(); it != languages.end(); ++it)
+		{
+			stream << "[" << Utils::quotify(it.key()) << "] = ";
+			Utils::writeReal(stream, map.value(*it));
+			stream << (it != --languages.end() ? ", " : "");
+		}
 		stream << "}";
 	}
 	else
 	{
 		// записываем одиночное значение
-		stream << *map.begin();
+		Utils::writeReal(stream, map.value(map.nextLanguage()));
 	}
 }
 
-bool GameObject::readStringMap(LuaScript &script, const QString &name, StringMap &map)
+bool GameObject::readStringMap(LuaScript &script, StringMap &map)
 {
 	// очищаем список локализации
 	map.clear();
 
 	// пробуем получить одиночное значение
 	QString value;
-	if (script.getString(name, value))
+	if (script.getString(value, false))
 	{
-		map[Project::getSingleton().getDefaultLanguage()] = value;
+		script.popValue();
+		map.insert(Project::getSingleton().getDefaultLanguageId(), value);
 		return true;
 	}
 
 	// пробуем получить таблицу с локализованными значениями
-	if (script.pushTable(name))
+	if (script.pushTable())
 	{
 		// получаем все элементы таблицы
 		script.firstEntry();
@@ -402,14 +550,14 @@ bool GameObject::readStringMap(LuaScript &script, const QString &name, StringMap
 			QString key;
 			if (!script.getString(value) || !script.getString(key, false))
 				return false;
-			map[key] = value;
+			map.insert(Project::getSingleton().getLanguageId(key), value);
 		}
 
 		// извлекаем таблицу из стека
 		script.popTable();
 
 		// проверяем, что в списке есть язык по умолчанию
-		return map.contains(Project::getSingleton().getDefaultLanguage());
+		return map.contains(Project::getSingleton().getDefaultLanguageId());
 	}
 
 	return false;
@@ -418,18 +566,19 @@ bool GameObject::readStringMap(LuaScript &script, const QString &name, StringMap
 void GameObject::writeStringMap(QTextStream &stream, const StringMap &map)
 {
 	// записываем значение свойства
-	Q_ASSERT(!map.empty());
+	Q_ASSERT(!map.isEmpty());
 	if (map.size() > 1)
 	{
-		// записываем таблицу
+		// записываем таблицу, упорядочивая языки по кодам
+		QMap<QString, int> languages = map.getLanguagesByCode();
 		stream << "{";
-		for (StringMap::const_iterator it = map.begin(); it != map.end(); ++it)
-			stream << "[" << Utils::quotify(it.key()) << "] = " << Utils::quotify(*it) << (it != --map.end() ? ", " : "");
+		for (QMap<QString, int>::const_iterator it = languages.begin(); it != languages.end(); ++it)
+			stream << "[" << Utils::quotify(it.key()) << "] = " << Utils::quotify(map.value(*it)) << (it != --languages.end() ? ", " : "");
 		stream << "}";
 	}
 	else
 	{
 		// записываем одиночное значение
-		stream << Utils::quotify(*map.begin());
+		stream << Utils::quotify(map.value(map.nextLanguage()));
 	}
 }
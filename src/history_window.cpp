@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "history_window.h"
+#include "options.h"
 
 HistoryWindow::HistoryWindow(QWidget *parent)
 : QDockWidget(parent)
@@ -15,4 +16,16 @@ void HistoryWindow::setUndoStack(QUndoStack *undoStack)
 {
 	mUndoView->setStack(undoStack);
 	mUndoView->setEnabled(undoStack != NULL);
+	if (undoStack == NULL)
+		mUndoMemoryLabel->clear();
+}
+
+void HistoryWindow::setUndoMemoryUsage(qint64 bytes)
+{
+	// показываем занятую память вместе с ограничением из настроек
+	QString text = QString("Память истории: %1 КБ").arg((bytes + 1023) / 1024);
+	int limit = Options::getSingleton().getUndoMemoryLimit();
+	if (limit != 0)
+		text += QString(" из %1 МБ").arg(limit);
+	mUndoMemoryLabel->setText(text);
 }
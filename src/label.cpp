@@ -4,15 +4,17 @@
 #include "layer.h"
 #include "lua_script.h"
 #include "project.h"
+#include "sprite_batch.h"
 #include "utils.h"
 
 Label::Label()
+: mLayoutValid(false)
 {
 }
 
 Label::Label(const QString &name, int id, const QPointF &pos, const QString &fileName, int size, Layer *parent)
 : GameObject(name, id, parent), mText(name), mFileName(fileName), mFontSize(size), mHorzAlignment(HORZ_ALIGN_LEFT),
-  mVertAlignment(VERT_ALIGN_TOP), mLineSpacing(1.0), mColor(Qt::white)
+  mVertAlignment(VERT_ALIGN_TOP), mLineSpacing(1.0), mColor(Qt::white), mLayoutValid(false)
 {
 	// загружаем шрифт
 	mFont = FontManager::getSingleton().loadFont(mFileName, mFontSize);
@@ -25,7 +27,7 @@ Label::Label(const QString &name, int id, const QPointF &pos, const QString &fil
 	}
 
 	// инициализируем локализованные свойства
-	QString language = Project::getSingleton().getDefaultLanguage();
+	int language = Project::getSingleton().getDefaultLanguageId();
 	mPositionXMap[language] = mPosition.x();
 	mPositionYMap[language] = mPosition.y();
 	mWidthMap[language] = mSize.width();
@@ -41,19 +43,22 @@ Label::Label(const QString &name, int id, const QPointF &pos, const QString &fil
 
 Label::~Label()
 {
-	// устанавливаем текущий контекст OpenGL для корректного удаления текстуры шрифта
-	FontManager::getSingleton().makeCurrent();
+	// устанавливаем текущий контекст OpenGL для корректного удаления текстуры шрифта, если шрифты загружались
+	if (!mFontMap.isEmpty())
+		FontManager::getSingleton().makeCurrent();
 }
 
 QString Label::getText() const
 {
-	StringMap::const_iterator it = mTranslationMap.find(Project::getSingleton().getCurrentLanguage());
-	return it != mTranslationMap.end() ? *it : mText;
+	int language = Project::getSingleton().getCurrentLanguageId();
+	return mTranslationMap.contains(language) ? mTranslationMap.value(language) : mText;
 }
 
 void Label::setText(const QString &text)
 {
 	mText = text;
+	invalidateLayout();
+	mUndoDirty = true;
 }
 
 QString Label::getFileName() const
@@ -69,9 +74,11 @@ void Label::setFileName(const QString &fileName)
 	mFont = FontManager::getSingleton().loadFont(mFileName, mFontSize);
 
 	// записываем локализованное имя файла и шрифт для текущего языка
-	QString language = Project::getSingleton().getCurrentLanguage();
+	int language = Project::getSingleton().getCurrentLanguageId();
 	mFileNameMap[language] = mFileName;
 	mFontMap[language] = mFont;
+	invalidateLayout();
+	mUndoDirty = true;
 }
 
 int Label::getFontSize() const
@@ -87,9 +94,11 @@ void Label::setFontSize(int size)
 	mFont = FontManager::getSingleton().loadFont(mFileName, mFontSize);
 
 	// записываем локализованный размер шрифта и шрифт для текущего языка
-	QString language = Project::getSingleton().getCurrentLanguage();
+	int language = Project::getSingleton().getCurrentLanguageId();
 	mFontSizeMap[language] = mFontSize;
 	mFontMap[language] = mFont;
+	invalidateLayout();
+	mUndoDirty = true;
 }
 
 Label::HorzAlignment Label::getHorzAlignment() const
@@ -100,6 +109,8 @@ Label::HorzAlignment Label::getHorzAlignment() const
 void Label::setHorzAlignment(HorzAlignment alignment)
 {
 	mHorzAlignment = alignment;
+	invalidateLayout();
+	mUndoDirty = true;
 }
 
 Label::VertAlignment Label::getVertAlignment() const
@@ -110,6 +121,8 @@ Label::VertAlignment Label::getVertAlignment() const
 void Label::setVertAlignment(VertAlignment alignment)
 {
 	mVertAlignment = alignment;
+	invalidateLayout();
+	mUndoDirty = true;
 }
 
 qreal Label::getLineSpacing() const
@@ -120,6 +133,8 @@ qreal Label::getLineSpacing() const
 void Label::setLineSpacing(qreal lineSpacing)
 {
 	mLineSpacing = lineSpacing;
+	invalidateLayout();
+	mUndoDirty = true;
 }
 
 QColor Label::getColor() const
@@ -130,6 +145,7 @@ QColor Label::getColor() const
 void Label::setColor(const QColor &color)
 {
 	mColor = color;
+	mUndoDirty = true;
 }
 
 bool Label::load(QDataStream &stream)
@@ -145,9 +161,8 @@ bool Label::load(QDataStream &stream)
 		return false;
 	mHorzAlignment = static_cast<HorzAlignment>(horzAlignment);
 	mVertAlignment = static_cast<VertAlignment>(vertAlignment);
+	invalidateLayout();
 
-	// загружаем локализованные шрифты
-	loadFonts();
 	return true;
 }
 
@@ -169,24 +184,59 @@ bool Label::save(QDataStream &stream)
 
 bool Label::load(LuaScript &script)
 {
-	// загружаем общие данные игрового объекта
-	if (!GameObject::load(script))
-		return false;
+	// загружаем общие данные игрового объекта и данные надписи; шрифты не загружаются, так как разбор
+	// Lua скрипта выполняется в рабочем потоке, а шрифты загружаются сценой функцией loadResources
+	return loadProperties(script, NUM_PROPERTIES);
+}
 
-	// загружаем данные надписи
-	int horzAlignment, vertAlignment;
+bool Label::loadProperty(LuaScript &script, int key, int &numProperties)
+{
+	int alignment;
 	unsigned int color;
-	if (!script.getString("text", mText) || !readStringMap(script, "fileName", mFileNameMap) || !readRealMap(script, "size", mFontSizeMap)
-		|| !script.getInt("horzAlignment", horzAlignment) || !script.getInt("vertAlignment", vertAlignment)
-		|| !script.getReal("lineSpacing", mLineSpacing) || !script.getUnsignedInt("color", color))
-		return false;
-	mHorzAlignment = static_cast<HorzAlignment>(horzAlignment);
-	mVertAlignment = static_cast<VertAlignment>(vertAlignment);
-	mColor = QColor::fromRgba(color);
+	bool result;
+	switch (key)
+	{
+	case KEY_TEXT:
+		result = script.getString(mText);
+		break;
+
+	case KEY_FILE_NAME:
+		result = readStringMap(script, mFileNameMap);
+		break;
+
+	case KEY_SIZE:
+		result = readRealMap(script, mFontSizeMap);
+		break;
+
+	case KEY_HORZ_ALIGNMENT:
+		result = script.getInt(alignment);
+		if (result)
+			mHorzAlignment = static_cast<HorzAlignment>(alignment);
+		break;
+
+	case KEY_VERT_ALIGNMENT:
+		result = script.getInt(alignment);
+		if (result)
+			mVertAlignment = static_cast<VertAlignment>(alignment);
+		break;
+
+	case KEY_LINE_SPACING:
+		result = script.getReal(mLineSpacing);
+		break;
+
+	case KEY_COLOR:
+		result = script.getUnsignedInt(color);
+		if (result)
+			mColor = QColor::fromRgba(color);
+		break;
+
+	default:
+		// загружаем общие свойства игрового объекта
+		return GameObject::loadProperty(script, key, numProperties);
+	}
 
-	// загружаем локализованные шрифты
-	loadFonts();
-	return true;
+	++numProperties;
+	return result;
 }
 
 bool Label::save(QTextStream &stream, int indent)
@@ -203,33 +253,35 @@ bool Label::save(QTextStream &stream, int indent)
 	writeStringMap(stream, mFileNameMap);
 	stream << ", size = ";
 	writeRealMap(stream, mFontSizeMap);
-	stream << ", horzAlignment = " << mHorzAlignment << ", vertAlignment = " << mVertAlignment
-		<< ", lineSpacing = " << mLineSpacing << ", color = 0x" << hex << mColor.rgba() << dec << "}";
+	stream << ", horzAlignment = " << mHorzAlignment << ", vertAlignment = " << mVertAlignment << ", lineSpacing = ";
+	Utils::writeReal(stream, mLineSpacing);
+	stream << ", color = 0x" << hex << mColor.rgba() << dec << "}";
 	return stream.status() == QTextStream::Ok;
 }
 
-void Label::setCurrentLanguage(const QString &language)
+void Label::setCurrentLanguage(int language)
 {
 	// устанавливаем язык для игрового объекта
 	GameObject::setCurrentLanguage(language);
 
 	// устанавливаем новые значения для имени файла, размера шрифта и объекта шрифта
-	QString currentLanguage = isLocalized() ? language : Project::getSingleton().getDefaultLanguage();
+	int currentLanguage = isLocalized() ? language : Project::getSingleton().getDefaultLanguageId();
 	mFileName = mFileNameMap[currentLanguage];
 	mFontSize = static_cast<int>(mFontSizeMap[currentLanguage]);
 	mFont = mFontMap[currentLanguage];
+	invalidateLayout();
 }
 
 bool Label::isLocalized() const
 {
-	QString language = Project::getSingleton().getCurrentLanguage();
+	int language = Project::getSingleton().getCurrentLanguageId();
 	return GameObject::isLocalized() && mFileNameMap.contains(language) && mFontSizeMap.contains(language) && mFontMap.contains(language);
 }
 
 void Label::setLocalized(bool localized)
 {
-	QString currentLanguage = Project::getSingleton().getCurrentLanguage();
-	QString defaultLanguage = Project::getSingleton().getDefaultLanguage();
+	int currentLanguage = Project::getSingleton().getCurrentLanguageId();
+	int defaultLanguage = Project::getSingleton().getDefaultLanguageId();
 	Q_ASSERT(currentLanguage != defaultLanguage);
 
 	// устанавливаем локализацию для игрового объекта
@@ -251,13 +303,14 @@ void Label::setLocalized(bool localized)
 	}
 
 	// устанавливаем текущий язык
-	setCurrentLanguage(Project::getSingleton().getCurrentLanguage());
+	setCurrentLanguage(Project::getSingleton().getCurrentLanguageId());
 }
 
 void Label::loadTranslations(LuaScript *script)
 {
 	// очищаем таблицу переводов
 	mTranslationMap.clear();
+	invalidateLayout();
 
 	// выходим, если скрипт не задан
 	if (script == NULL)
@@ -273,7 +326,7 @@ void Label::loadTranslations(LuaScript *script)
 	{
 		QString key, value;
 		if (script->getString(value) && script->getString(key, false))
-			mTranslationMap[key] = value;
+			mTranslationMap.insert(Project::getSingleton().getLanguageId(key), value);
 	}
 
 	// извлекаем таблицу переводов из стека
@@ -293,9 +346,9 @@ QStringList Label::getMissedFiles() const
 {
 	// возвращаем имена незагруженных шрифтов
 	QStringList missedFiles;
-	for (StringMap::const_iterator it = mFileNameMap.begin(); it != mFileNameMap.end(); ++it)
-		if (mFontMap[it.key()]->isDefault())
-			missedFiles.push_back(*it);
+	for (int language = mFileNameMap.nextLanguage(); language != -1; language = mFileNameMap.nextLanguage(language))
+		if (mFontMap[language]->isDefault())
+			missedFiles.push_back(mFileNameMap[language]);
 	return missedFiles;
 }
 
@@ -304,8 +357,27 @@ bool Label::changeTexture(const QString &fileName, const QSharedPointer<Texture>
 	return false;
 }
 
-void Label::draw()
+QRectF Label::getDrawingRect() const
 {
+	// без шрифта текст не отрисовывается
+	if (mFont.isNull())
+		return mBoundingRect;
+
+	// отражаем прямоугольник текста так же, как при отрисовке надписи с отрицательными размерами, и переводим в мировые координаты
+	updateLayout();
+	QRectF rect = mLayoutRect;
+	if (mSize.width() < 0.0)
+		rect.moveRight(-mLayoutRect.left());
+	if (mSize.height() < 0.0)
+		rect.moveBottom(-mLayoutRect.top());
+	return mTransform.mapRect(rect);
+}
+
+void Label::draw(SpriteBatch &batch)
+{
+	// отрисовываем накопленные спрайты, чтобы сохранить порядок отрисовки
+	batch.flush();
+
 	// сохраняем матрицу трансформации
 	glPushMatrix();
 
@@ -315,79 +387,117 @@ void Label::draw()
 	glRotated(mRotationAngle, 0.0, 0.0, 1.0);
 	glColor4d(mColor.redF(), mColor.greenF(), mColor.blueF(), mColor.alphaF());
 
-	// разбиваем текст на строки
-	QStringList lines;
-	qreal spaceWidth = mFont->getWidth(" ");
-	foreach (const QString &line, getText().split("\n"))
+	// выводим текст построчно по кэшу разбивки
+	updateLayout();
+	for (int i = 0; i < mLayoutLines.size(); ++i)
 	{
-		// разбиваем строку на слова
-		qreal width = 0.0, oldWidth = 0.0;
-		QString str;
-		foreach (const QString &word, line.split(" ", QString::SkipEmptyParts))
-		{
-			// определяем ширину текущего слова в пикселях
-			qreal wordWidth = mFont->getWidth(word);
-			width += wordWidth;
+		glPushMatrix();
+		glTranslated(mLayoutOffsets[i].x() * scale.x(), mLayoutOffsets[i].y() * scale.y(), 0.0);
+		glScaled(scale.x(), -scale.y(), 1.0);
+		mFont->draw(mLayoutLines[i]);
+		glPopMatrix();
+	}
 
-			// переносим строку, если ее суммарная ширина превышает ширину текстового прямоугольника
-			if (width >= qAbs(mSize.width()) && oldWidth > 0.0)
+	// восстанавливаем матрицу трансформации
+	glPopMatrix();
+}
+
+void Label::loadResources()
+{
+	// загружаем локализованные шрифты
+	mFontMap.clear();
+	for (int language = mFileNameMap.nextLanguage(); language != -1; language = mFileNameMap.nextLanguage(language))
+		mFontMap[language] = FontManager::getSingleton().loadFont(mFileNameMap[language], static_cast<int>(mFontSizeMap[language]));
+
+	// устанавливаем текущий язык
+	setCurrentLanguage(Project::getSingleton().getCurrentLanguageId());
+}
+
+void Label::invalidateLayout()
+{
+	// прямоугольник текста может измениться, поэтому сбрасываем и ограничивающий прямоугольник слоя
+	mLayoutValid = false;
+	if (mParentLayer != NULL)
+		mParentLayer->invalidateBoundingRect();
+}
+
+void Label::updateLayout() const
+{
+	// выходим, если разбивка рассчитана для текущих размеров надписи
+	QSizeF size(qAbs(mSize.width()), qAbs(mSize.height()));
+	if (mLayoutValid && mLayoutSize == size)
+		return;
+
+	// переносим слова, только если изменился текст, шрифт или ширина надписи
+	if (!mLayoutValid || mLayoutSize.width() != size.width())
+	{
+		// разбиваем текст на строки
+		QStringList lines;
+		qreal spaceWidth = mFont->getWidth(" ");
+		foreach (const QString &line, getText().split("\n"))
+		{
+			// разбиваем строку на слова
+			qreal width = 0.0, oldWidth = 0.0;
+			QString str;
+			foreach (const QString &word, line.split(" ", QString::SkipEmptyParts))
 			{
-				lines.push_back(str.left(str.size() - 1));
-				str.clear();
-				width = wordWidth;
+				// определяем ширину текущего слова в пикселях
+				qreal wordWidth = mFont->getWidth(word);
+				width += wordWidth;
+
+				// переносим строку, если ее суммарная ширина превышает ширину текстового прямоугольника
+				if (width >= size.width() && oldWidth > 0.0)
+				{
+					lines.push_back(str.left(str.size() - 1));
+					str.clear();
+					width = wordWidth;
+				}
+
+				// склеиваем слова в строке, разделяя их пробелами
+				str += word + " ";
+				width += spaceWidth;
+				oldWidth = width;
 			}
 
-			// склеиваем слова в строке, разделяя их пробелами
-			str += word + " ";
-			width += spaceWidth;
-			oldWidth = width;
+			// добавляем последнюю строку в список строк
+			lines.push_back(str.left(str.size() - 1));
 		}
 
-		// добавляем последнюю строку в список строк
-		lines.push_back(str.left(str.size() - 1));
+		// запоминаем строки в виде, пригодном для отрисовки, и их ширины
+		mLayoutLines.clear();
+		mLayoutWidths.clear();
+		foreach (const QString &line, lines)
+		{
+			mLayoutLines.push_back(Utils::toStdWString(line));
+			mLayoutWidths.push_back(mFont->getWidth(line));
+		}
 	}
 
 	// определяем начальную координату по оси Y с учетом вертикального выравнивания
 	qreal y = 0.0;
-	qreal height = ((lines.size() - 1) * mLineSpacing + 1.0) * mFont->getHeight();
+	qreal height = ((mLayoutLines.size() - 1) * mLineSpacing + 1.0) * mFont->getHeight();
 	if (mVertAlignment == VERT_ALIGN_CENTER)
-		y = (qAbs(mSize.height()) - height) / 2.0;
+		y = (size.height() - height) / 2.0;
 	else if (mVertAlignment == VERT_ALIGN_BOTTOM)
-		y = qAbs(mSize.height()) - height;
+		y = size.height() - height;
 
-	// выводим текст построчно
-	foreach (const QString &line, lines)
+	// рассчитываем смещения строк с учетом горизонтального выравнивания и охватывающий их прямоугольник
+	mLayoutOffsets.clear();
+	mLayoutRect = QRectF(QPointF(0.0, 0.0), size);
+	foreach (qreal width, mLayoutWidths)
 	{
-		// определяем координату текущей строки по оси X с учетом горизонтального выравнивания
 		qreal x = 0.0;
-		qreal width = mFont->getWidth(line);
 		if (mHorzAlignment == HORZ_ALIGN_CENTER)
-			x = (qAbs(mSize.width()) - width) / 2.0;
+			x = (size.width() - width) / 2.0;
 		else if (mHorzAlignment == HORZ_ALIGN_RIGHT)
-			x = qAbs(mSize.width()) - width;
-
-		// отрисовываем текущую строку
-		glPushMatrix();
-		glTranslated(qCeil(x) * scale.x(), (qCeil(y) + qRound(mFont->getHeight() / 1.25)) * scale.y(), 0.0);
-		glScaled(scale.x(), -scale.y(), 1.0);
-		mFont->draw(line);
-		glPopMatrix();
+			x = size.width() - width;
+		mLayoutOffsets.push_back(QPointF(qCeil(x), qCeil(y) + qRound(mFont->getHeight() / 1.25)));
+		mLayoutRect |= QRectF(qCeil(x), qCeil(y), width, mFont->getHeight());
 
 		// переходим на следующую строку текста
 		y += mFont->getHeight() * mLineSpacing;
 	}
 
-	// восстанавливаем матрицу трансформации
-	glPopMatrix();
-}
-
-void Label::loadFonts()
-{
-	// загружаем локализованные шрифты
-	mFontMap.clear();
-	for (StringMap::const_iterator it = mFileNameMap.begin(); it != mFileNameMap.end(); ++it)
-		mFontMap[it.key()] = FontManager::getSingleton().loadFont(*it, static_cast<int>(mFontSizeMap[it.key()]));
-
-	// устанавливаем текущий язык
-	setCurrentLanguage(Project::getSingleton().getCurrentLanguage());
+	mLayoutSize = size;
+	mLayoutValid = true;
 }
@@ -3,18 +3,20 @@
 #include "label.h"
 #include "lua_script.h"
 #include "sprite.h"
+#include "sprite_batch.h"
 
 Layer::Layer()
+: mGameObjectIndicesValid(false)
 {
 }
 
 Layer::Layer(const QString &name, BaseLayer *parent, int index)
-: BaseLayer(name, parent, index)
+: BaseLayer(name, parent, index), mGameObjectIndicesValid(false)
 {
 }
 
 Layer::Layer(const Layer &layer)
-: BaseLayer(layer)
+: BaseLayer(layer), mGameObjectIndicesValid(false)
 {
 	// дублируем все дочерние игровые объекты
 	for (int i = layer.mGameObjects.size() - 1; i >= 0; --i)
@@ -49,12 +51,35 @@ void Layer::insertGameObject(int index, GameObject *object)
 	{
 		object->setParentLayer(this);
 		mGameObjects.insert(index, object);
+		mSpatialIndex.insert(object);
+		getTreeNameIndex().insert(object->getName(), object);
+		mGameObjectIndicesValid = false;
+		mUndoDirty = true;
+		invalidateBoundingRect();
 	}
 }
 
 void Layer::removeGameObject(int index)
 {
-	mGameObjects.takeAt(index)->setParentLayer(NULL);
+	GameObject *object = mGameObjects.takeAt(index);
+	object->setParentLayer(NULL);
+	mSpatialIndex.remove(object);
+	getTreeNameIndex().remove(object->getName(), object);
+	mGameObjectIndicesValid = false;
+	mUndoDirty = true;
+	invalidateBoundingRect();
+}
+
+void Layer::updateSpatialIndex(GameObject *object)
+{
+	mSpatialIndex.update(object);
+}
+
+void Layer::updateNameIndex(GameObject *object, const QString &oldName)
+{
+	NameIndex &nameIndex = getTreeNameIndex();
+	nameIndex.remove(oldName, object);
+	nameIndex.insert(object->getName(), object);
 }
 
 bool Layer::load(QDataStream &stream)
@@ -188,11 +213,16 @@ bool Layer::save(QTextStream &stream, int indent)
 
 QRectF Layer::getBoundingRect() const
 {
-	// определяем общий ограничивающий прямоугольник для всех игровых объектов
-	QRectF rect = !mGameObjects.empty() ? mGameObjects.front()->getBoundingRect() : QRectF();
-	foreach (GameObject *object, mGameObjects)
-		rect |= object->getBoundingRect();
-	return rect;
+	// пересчитываем общий ограничивающий прямоугольник для всего отрисовываемого игровыми объектами, если он устарел
+	if (!mBoundingRectValid)
+	{
+		mBoundingRect = !mGameObjects.empty() ? mGameObjects.front()->getDrawingRect() : QRectF();
+		foreach (GameObject *object, mGameObjects)
+			mBoundingRect |= object->getDrawingRect();
+		mBoundingRectValid = true;
+	}
+
+	return mBoundingRect;
 }
 
 QList<GameObject *> Layer::getGameObjects() const
@@ -206,37 +236,48 @@ QList<GameObject *> Layer::findActiveGameObjects() const
 	return mVisibleState == LAYER_VISIBLE && mLockState == LAYER_UNLOCKED ? mGameObjects : QList<GameObject *>();
 }
 
-GameObject *Layer::findGameObjectByName(const QString &name) const
+QList<GameObject *> Layer::findVisibleGameObjects() const
 {
-	// ищем игровой объект в списке дочерних объектов
-	foreach (GameObject *object, mGameObjects)
-		if (object->getName() == name)
-			return object;
-	return NULL;
+	// возвращаем список объектов, если слой видим
+	return mVisibleState == LAYER_VISIBLE ? mGameObjects : QList<GameObject *>();
 }
 
 GameObject *Layer::findGameObjectByPoint(const QPointF &pt) const
 {
-	// ищем объект в списке, если слой видим и не заблокирован
+	// ищем самый верхний объект среди найденных пространственным индексом, если слой видим и не заблокирован
+	GameObject *foundObject = NULL;
 	if (mVisibleState == LAYER_VISIBLE && mLockState == LAYER_UNLOCKED)
 	{
-		foreach (GameObject *object, mGameObjects)
-			if (object->isContainPoint(pt))
-				return object;
+		const QHash<GameObject *, int> &indices = getGameObjectIndices();
+		int foundIndex = mGameObjects.size();
+		foreach (GameObject *object, mSpatialIndex.findObjects(pt))
+		{
+			int index = indices.value(object);
+			if (index < foundIndex && object->isContainPoint(pt))
+			{
+				foundObject = object;
+				foundIndex = index;
+			}
+		}
 	}
 
-	return NULL;
+	return foundObject;
 }
 
 QList<GameObject *> Layer::findGameObjectsByRect(const QRectF &rect) const
 {
-	// ищем объекты в списке, если слой видим и не заблокирован
+	// ищем объекты среди найденных пространственным индексом, если слой видим и не заблокирован
 	QList<GameObject *> objects;
 	if (mVisibleState == LAYER_VISIBLE && mLockState == LAYER_UNLOCKED)
 	{
-		foreach (GameObject *object, mGameObjects)
+		const QHash<GameObject *, int> &indices = getGameObjectIndices();
+		QMap<int, GameObject *> sortedObjects;
+		foreach (GameObject *object, mSpatialIndex.findObjects(rect))
 			if (object->isContainedInRect(rect))
-				objects.push_back(object);
+				sortedObjects.insert(indices.value(object), object);
+
+		// возвращаем объекты в порядке их следования в списке
+		objects = sortedObjects.values();
 	}
 
 	return objects;
@@ -274,14 +315,18 @@ void Layer::snapYCoord(qreal y, qreal x1, qreal x2, const QList<GameObject *> &e
 	}
 }
 
-void Layer::setCurrentLanguage(const QString &language)
+bool Layer::updateCurrentLanguage()
 {
-	// устанавливаем текущий язык для всех дочерних игровых объектов
+	// переключаем на текущий язык дочерние игровые объекты с устаревшим языком
+	bool changed = false;
 	foreach (GameObject *object, mGameObjects)
-		object->setCurrentLanguage(language);
+		if (object->updateCurrentLanguage())
+			changed = true;
 
-	// удаляем иконку предпросмотра
-	mThumbnail = QIcon();
+	// удаляем иконку предпросмотра, если объекты изменились
+	if (changed)
+		mThumbnail = QIcon();
+	return changed;
 }
 
 void Layer::loadTranslations(LuaScript *script)
@@ -320,12 +365,43 @@ QList<GameObject *> Layer::changeTexture(const QString &fileName, const QSharedP
 	return objects;
 }
 
-void Layer::draw(bool ignoreVisibleState)
+void Layer::draw(SpriteBatch &batch, const QRectF &visibleRect, bool ignoreVisibleState)
 {
 	// отрисовываем все объекты в слое от нижнего к верхнему, если слой видим
 	if (ignoreVisibleState || mVisibleState == LAYER_VISIBLE)
 	{
+		// отбрасываем слой целиком, если он не попадает в видимую область
+		if (!visibleRect.intersects(getBoundingRect()))
+		{
+			batch.addCulledObjects(mGameObjects.size());
+			return;
+		}
+
+		// отрисовываем только объекты, попадающие в видимую область
+		int numCulledObjects = 0;
 		for (int i = mGameObjects.size() - 1; i >= 0; --i)
-			mGameObjects[i]->draw();
+		{
+			if (visibleRect.intersects(mGameObjects[i]->getDrawingRect()))
+				mGameObjects[i]->draw(batch);
+			else
+				++numCulledObjects;
+		}
+
+		batch.addCulledObjects(numCulledObjects);
 	}
 }
+
+const QHash<GameObject *, int> &Layer::getGameObjectIndices() const
+{
+	// пересчитываем индексы игровых объектов, если список изменился
+	if (!mGameObjectIndicesValid)
+	{
+		mGameObjectIndices.clear();
+		mGameObjectIndices.reserve(mGameObjects.size());
+		for (int i = 0; i < mGameObjects.size(); ++i)
+			mGameObjectIndices.insert(mGameObjects[i], i);
+		mGameObjectIndicesValid = true;
+	}
+
+	return mGameObjectIndices;
+}
@@ -2,6 +2,7 @@
 #include "layer_group.h"
 #include "layer.h"
 #include "lua_script.h"
+#include "sprite_batch.h"
 
 LayerGroup::LayerGroup()
 {
@@ -143,11 +144,16 @@ bool LayerGroup::save(QTextStream &stream, int indent)
 
 QRectF LayerGroup::getBoundingRect() const
 {
-	// определяем общий ограничивающий прямоугольник для всех дочерних слоев
-	QRectF rect = !mChildLayers.empty() ? mChildLayers.front()->getBoundingRect() : QRectF();
-	foreach (BaseLayer *layer, mChildLayers)
-		rect |= layer->getBoundingRect();
-	return rect;
+	// пересчитываем общий ограничивающий прямоугольник для всех дочерних слоев, если он устарел
+	if (!mBoundingRectValid)
+	{
+		mBoundingRect = !mChildLayers.empty() ? mChildLayers.front()->getBoundingRect() : QRectF();
+		foreach (BaseLayer *layer, mChildLayers)
+			mBoundingRect |= layer->getBoundingRect();
+		mBoundingRectValid = true;
+	}
+
+	return mBoundingRect;
 }
 
 QList<GameObject *> LayerGroup::getGameObjects() const
@@ -159,6 +165,15 @@ QList<GameObject *> LayerGroup::getGameObjects() const
 	return objects;
 }
 
+int LayerGroup::getNumGameObjects() const
+{
+	// суммируем количество объектов в дочерних слоях
+	int numGameObjects = 0;
+	foreach (BaseLayer *layer, mChildLayers)
+		numGameObjects += layer->getNumGameObjects();
+	return numGameObjects;
+}
+
 QList<GameObject *> LayerGroup::findActiveGameObjects() const
 {
 	// получаем список объектов в дочерних слоях от верхнего к нижнему, если группа слоев видима и не заблокирована
@@ -172,17 +187,17 @@ QList<GameObject *> LayerGroup::findActiveGameObjects() const
 	return objects;
 }
 
-GameObject *LayerGroup::findGameObjectByName(const QString &name) const
+QList<GameObject *> LayerGroup::findVisibleGameObjects() const
 {
-	// ищем игровой объект в списке дочерних слоев
-	foreach (BaseLayer *layer, mChildLayers)
+	// получаем список объектов в дочерних слоях от верхнего к нижнему, если группа слоев видима
+	QList<GameObject *> objects;
+	if (mVisibleState == LAYER_VISIBLE)
 	{
-		GameObject *object = layer->findGameObjectByName(name);
-		if (object != NULL)
-			return object;
+		foreach (BaseLayer *layer, mChildLayers)
+			objects.append(layer->findVisibleGameObjects());
 	}
 
-	return NULL;
+	return objects;
 }
 
 GameObject *LayerGroup::findGameObjectByPoint(const QPointF &pt) const
@@ -240,14 +255,18 @@ void LayerGroup::snapYCoord(qreal y, qreal x1, qreal x2, const QList<GameObject
 			layer->snapYCoord(y, x1, x2, excludedObjects, snappedY, distance, line);
 }
 
-void LayerGroup::setCurrentLanguage(const QString &language)
+bool LayerGroup::updateCurrentLanguage()
 {
-	// устанавливаем текущий язык для всех дочерних слоев
+	// переключаем на текущий язык все дочерние слои
+	bool changed = false;
 	foreach (BaseLayer *layer, mChildLayers)
-		layer->setCurrentLanguage(language);
+		if (layer->updateCurrentLanguage())
+			changed = true;
 
-	// удаляем иконку предпросмотра
-	mThumbnail = QIcon();
+	// удаляем иконку предпросмотра, если дочерние слои изменились
+	if (changed)
+		mThumbnail = QIcon();
+	return changed;
 }
 
 void LayerGroup::loadTranslations(LuaScript *script)
@@ -285,12 +304,19 @@ QList<GameObject *> LayerGroup::changeTexture(const QString &fileName, const QSh
 	return objects;
 }
 
-void LayerGroup::draw(bool ignoreVisibleState)
+void LayerGroup::draw(SpriteBatch &batch, const QRectF &visibleRect, bool ignoreVisibleState)
 {
 	// отрисовываем все дочерние слои от нижнего к верхнему, если группа слоев видима
 	if (ignoreVisibleState || mVisibleState == LAYER_VISIBLE)
 	{
+		// отбрасываем группу целиком, если она не попадает в видимую область
+		if (!visibleRect.intersects(getBoundingRect()))
+		{
+			batch.addCulledObjects(getNumGameObjects());
+			return;
+		}
+
 		for (int i = mChildLayers.size() - 1; i >= 0; --i)
-			mChildLayers[i]->draw();
+			mChildLayers[i]->draw(batch, visibleRect);
 	}
 }
@@ -1126,7 +1126,8 @@ QIcon LayersTreeWidget::createLayerIcon(BaseLayer *baseLayer)
 	glTranslated((WIDTH_THUMBNAIL - rect.width() * scale) / 2.0, (HEIGHT_THUMBNAIL - rect.height() * scale) / 2.0, 0.0);
 	glScaled(scale, scale, 1.0);
 	glTranslated(-rect.left(), -rect.top(), 0.0);
-	baseLayer->draw(true);
+	baseLayer->draw(mSpriteBatch, rect, true);
+	mSpriteBatch.flush();
 
 	// отрисовка рамки по краю
 	QPainter painter(mFrameBuffer);
@@ -230,3 +230,29 @@ void LuaScript::popTable()
 	lua_pop(mLuaState, 1);
 	--mTableIndex;
 }
+
+void LuaScript::popValue()
+{
+	lua_pop(mLuaState, 1);
+}
+
+void LuaScript::registerKeys(const char *const *names, int count)
+{
+	// строки в Lua интернированы, поэтому одинаковые ключи имеют один адрес и сравниваются без учета содержимого;
+	// ссылки в реестре не дают сборщику мусора удалить строки ключей
+	mKeys.clear();
+	for (int i = 0; i < count; ++i)
+	{
+		lua_pushstring(mLuaState, names[i]);
+		mKeys.insert(lua_tostring(mLuaState, -1), i);
+		luaL_ref(mLuaState, LUA_REGISTRYINDEX);
+	}
+}
+
+int LuaScript::getEntryKey() const
+{
+	// проверяем тип ключа, так как lua_tostring преобразует числовой ключ на месте и нарушает обход таблицы
+	if (lua_type(mLuaState, -2) != LUA_TSTRING)
+		return -1;
+	return mKeys.value(lua_tostring(mLuaState, -2), -1);
+}
@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "main_window.h"
+#include "directory_cache.h"
 #include "editor_window.h"
 #include "font_browser.h"
 #include "font_manager.h"
@@ -9,12 +10,13 @@
 #include "options_dialog.h"
 #include "project.h"
 #include "property_window.h"
+#include "scene.h"
 #include "sprite_browser.h"
 #include "texture_manager.h"
 #include "utils.h"
 
 MainWindow::MainWindow()
-: mRenderEnabled(true), mUntitledIndex(1), mTabWidgetCurrentIndex(-1), mTranslationCounter(0)
+: mUntitledIndex(1), mTabWidgetCurrentIndex(-1), mReportingParseErrors(false), mRecoveryIndex(1)
 {
 	setupUi(this);
 
@@ -24,16 +26,13 @@ MainWindow::MainWindow()
 	mPrimaryGLWidget = new QGLWidget(format, this);
 	mPrimaryGLWidget->setVisible(false);
 
-	// создаем вспомогательный OpenGL виджет для загрузки текстур в фоновом потоке и расшариваем его с основным
-	mSecondaryGLWidget = new QGLWidget(format, this, mPrimaryGLWidget);
-	mSecondaryGLWidget->setVisible(false);
-
 	// создаем синглетоны
 	QSettings settings;
 	new Options(settings);
+	new DirectoryCache();
 	new Project();
 	new FontManager(mPrimaryGLWidget);
-	new TextureManager(mPrimaryGLWidget, mSecondaryGLWidget);
+	new TextureManager(mPrimaryGLWidget);
 
 	// открываем проект
 	QStringList arguments = QCoreApplication::arguments();
@@ -209,9 +208,9 @@ MainWindow::MainWindow()
 	connect(mPropertyWindow, SIGNAL(allowedEditorActionsChanged()), this, SLOT(onPropertyWindowAllowedEditorActionsChanged()));
 	connect(mPropertyWindow, SIGNAL(layerChanged(BaseLayer *)), mLayersWindow, SIGNAL(layerChanged(BaseLayer *)));
 
-	// связываем сигнал об изменении текстуры
-	connect(TextureManager::getSingletonPtr(), SIGNAL(textureChanged(const QString &, const QSharedPointer<Texture> &)),
-		this, SLOT(onTextureChanged(const QString &, const QSharedPointer<Texture> &)));
+	// связываем сигнал об изменении текстур
+	connect(TextureManager::getSingletonPtr(), SIGNAL(texturesChanged(const TextureManager::TextureMap &)),
+		this, SLOT(onTexturesChanged(const TextureManager::TextureMap &)));
 
 	// связываем сигнал об изменении содержимого буфера обмена
 	connect(QApplication::clipboard(), SIGNAL(dataChanged()), this, SLOT(onClipboardDataChanged()));
@@ -225,12 +224,23 @@ MainWindow::MainWindow()
 	// создаем новый документ
 	on_mNewAction_triggered();
 
-	// запускаем таймер на ~60 Гц для рендеринга
-	startTimer(16);
+	// запускаем таймер для проверки файлов переводов, окна редактора перерисовываются только при изменениях
+	startTimer(250);
+
+	// создаем таймер автосохранения копий измененных сцен для восстановления после аварийного завершения
+	mAutosaveTimer = new QTimer(this);
+	connect(mAutosaveTimer, SIGNAL(timeout()), this, SLOT(onAutosaveTimeout()));
+	updateAutosaveTimer();
+
+	// предлагаем восстановить сцены после показа главного окна
+	QTimer::singleShot(0, this, SLOT(restoreRecoveryFiles()));
 }
 
 MainWindow::~MainWindow()
 {
+	// рабочие потоки обращаются к синглетонам, поэтому дожидаемся их завершения до удаления синглетонов
+	waitForWorkers();
+
 	// удаляем объекты редактора
 	delete mSpriteBrowser;
 	delete mFontBrowser;
@@ -242,6 +252,7 @@ MainWindow::~MainWindow()
 	TextureManager::destroy();
 	FontManager::destroy();
 	Project::destroy();
+	DirectoryCache::destroy();
 	Options::destroy();
 }
 
@@ -255,49 +266,30 @@ EditorWindow *MainWindow::getEditorWindow(int index) const
 	return static_cast<EditorWindow *>(mTabWidget->widget(index));
 }
 
-bool MainWindow::event(QEvent *event)
-{
-	// разрешаем/запрещаем отрисовку по таймеру при блокировке/разблокировке главного окна модальными диалогами
-	if (event->type() == QEvent::WindowBlocked)
-		mRenderEnabled = false;
-	else if (event->type() == QEvent::WindowUnblocked)
-		mRenderEnabled = true;
-
-	return QMainWindow::event(event);
-}
-
 void MainWindow::timerEvent(QTimerEvent *event)
 {
-	// перерисовываем текущую открытую вкладку
-	if (mRenderEnabled && mTabWidget->currentWidget() != NULL)
-		mTabWidget->currentWidget()->update();
-
 	// обновляем состояния файлов переводов
-	if (++mTranslationCounter >= 15)
-	{
-		mTranslationCounter = 0;
-		for (TranslationFilesMap::iterator it = mTranslationFilesMap.begin(); it != mTranslationFilesMap.end(); ++it)
-			if (it->mChanged)
+	for (TranslationFilesMap::iterator it = mTranslationFilesMap.begin(); it != mTranslationFilesMap.end(); ++it)
+		if (it->mChanged)
+		{
+			// если с момента последнего изменения файла переводов прошло достаточно много времени, загружаем его
+			if (it->mTimer.hasExpired(250))
 			{
-				// если с момента последнего изменения файла переводов прошло достаточно много времени, загружаем его
-				if (it->mTimer.hasExpired(250))
-				{
-					it->mChanged = false;
-					it->mEditorWindow->loadTranslationFile(it.key());
-					if (!mTranslationFilesWatcher->files().contains(it.key()) && Utils::fileExists(it.key()))
-						mTranslationFilesWatcher->addPath(it.key());
-				}
+				it->mChanged = false;
+				it->mEditorWindow->loadTranslationFile(it.key());
+				if (!mTranslationFilesWatcher->files().contains(it.key()) && Utils::fileExists(it.key()))
+					mTranslationFilesWatcher->addPath(it.key());
 			}
-			else if (!mTranslationFilesWatcher->files().contains(it.key()))
+		}
+		else if (!mTranslationFilesWatcher->files().contains(it.key()))
+		{
+			// если файл переводов был удален, а потом восстановлен, загружаем его
+			if (Utils::fileExists(it.key()))
 			{
-				// если файл переводов был удален, а потом восстановлен, загружаем его
-				if (Utils::fileExists(it.key()))
-				{
-					it->mEditorWindow->loadTranslationFile(it.key());
-					mTranslationFilesWatcher->addPath(it.key());
-				}
+				it->mEditorWindow->loadTranslationFile(it.key());
+				mTranslationFilesWatcher->addPath(it.key());
 			}
-	}
+		}
 }
 
 void MainWindow::closeEvent(QCloseEvent *event)
@@ -305,6 +297,9 @@ void MainWindow::closeEvent(QCloseEvent *event)
 	// закрываем все открытые вкладки и сохраняем текущий открытый проект и настройки приложения перед выходом
 	if (on_mCloseAllAction_triggered())
 	{
+		// отбрасываем сцены, разбор которых еще не завершен, чтобы они не открылись после закрытия вкладок
+		waitForWorkers();
+
 		// сохраняем текущий открытый проект
 		Project::getSingleton().save();
 
@@ -327,8 +322,7 @@ void MainWindow::closeEvent(QCloseEvent *event)
 void MainWindow::on_mNewAction_triggered()
 {
 	// создаем новую вкладку с окном редактора и переключаемся на нее
-	QString fileName = mUntitledIndex == 1 ? "untitled.lua" : QString("untitled_%1.lua").arg(mUntitledIndex);
-	++mUntitledIndex;
+	QString fileName = generateUntitledFileName();
 	EditorWindow *editorWindow = createEditorWindow(fileName);
 	mTabWidget->addTab(editorWindow, fileName);
 	mTabWidget->setCurrentWidget(editorWindow);
@@ -337,57 +331,18 @@ void MainWindow::on_mNewAction_triggered()
 
 void MainWindow::on_mOpenAction_triggered()
 {
-	// показываем диалоговое окно открытия файла
-	QString fileName = qobject_cast<QAction *>(sender())->data().toString();
+	// показываем диалоговое окно открытия файлов, если файл не задан пунктом меню последних файлов
+	QStringList fileNames;
+	QString recentFileName = qobject_cast<QAction *>(sender())->data().toString();
 	QString filter = "Файлы " + QCoreApplication::applicationName() + " (*.lua);;Все файлы (*)";
-	if (fileName.isEmpty())
-		fileName = QFileDialog::getOpenFileName(this, "Открыть", Options::getSingleton().getLastOpenedDirectory(), filter);
-	if (!Utils::isFileNameValid(fileName, Project::getSingleton().getRootDirectory() + Project::getSingleton().getScenesDirectory(), this))
-		return;
-
-	// сохраняем каталог с выбранным файлом
-	Options::getSingleton().setLastOpenedDirectory(QFileInfo(fileName).path());
-
-	// проверяем, не открыт ли уже этот файл
-	for (int i = 0; i < mTabWidget->count(); ++i)
-		if (getEditorWindow(i)->getFileName() == fileName)
-		{
-			mTabWidget->setCurrentIndex(i);
-			updateRecentFilesActions(fileName);
-			return;
-		}
-
-	// создаем новую вкладку с окном редактора
-	EditorWindow *editorWindow = createEditorWindow(fileName);
-
-	// открываем файл
-	if (!editorWindow->load(fileName))
-	{
-		delete editorWindow;
-		on_mTabWidget_currentChanged(mTabWidget->currentIndex());
-		QMessageBox::critical(this, "", "Ошибка открытия файла " + fileName);
-		return;
-	}
-
-	// загружаем файл переводов
-	QString translationFileName = getTranslationFileName(fileName);
-	editorWindow->loadTranslationFile(translationFileName);
-
-	// добавляем файл переводов на слежение
-	mTranslationFilesMap.insert(translationFileName, TranslationFileInfo(editorWindow));
-	if (!mTranslationFilesWatcher->files().contains(translationFileName) && Utils::fileExists(translationFileName))
-		mTranslationFilesWatcher->addPath(translationFileName);
-
-	// создаем новую вкладку и переключаемся на нее
-	mTabWidget->addTab(editorWindow, QFileInfo(fileName).fileName());
-	mTabWidget->setCurrentWidget(editorWindow);
-	onClipboardDataChanged();
-
-	// обновляем список последних файлов
-	updateRecentFilesActions(fileName);
+	if (recentFileName.isEmpty())
+		fileNames = QFileDialog::getOpenFileNames(this, "Открыть", Options::getSingleton().getLastOpenedDirectory(), filter);
+	else
+		fileNames.push_back(recentFileName);
 
-	// проверяем сцену на наличие отсутствующих файлов
-	checkMissedFiles();
+	// открываем файлы, разбирая их параллельно
+	foreach (const QString &fileName, fileNames)
+		openFile(fileName);
 }
 
 bool MainWindow::on_mSaveAction_triggered()
@@ -404,7 +359,8 @@ bool MainWindow::on_mSaveAction_triggered()
 		return false;
 	}
 
-	// обновляем звездочку в имени вкладки
+	// удаляем ставший ненужным файл восстановления и обновляем звездочку в имени вкладки
+	removeRecoveryFile(editorWindow);
 	updateUndoRedoActions();
 	return true;
 }
@@ -429,7 +385,8 @@ bool MainWindow::on_mSaveAsAction_triggered()
 		return false;
 	}
 
-	// обновляем список последних файлов и звездочку в имени вкладки
+	// удаляем ставший ненужным файл восстановления, обновляем список последних файлов и звездочку в имени вкладки
+	removeRecoveryFile(editorWindow);
 	updateRecentFilesActions(fileName);
 	updateUndoRedoActions();
 	return true;
@@ -494,8 +451,10 @@ void MainWindow::on_mOptionsAction_triggered()
 	OptionsDialog dialog(this);
 	dialog.exec();
 
-	// обновляем пункты главного меню
+	// обновляем пункты главного меню, интервал автосохранения и перерисовываем окно редактора
 	updateMainMenuActions();
+	updateAutosaveTimer();
+	updateCurrentEditorWindow();
 }
 
 void MainWindow::on_mSelectAllAction_triggered()
@@ -538,26 +497,31 @@ void MainWindow::on_mZoomOutAction_triggered()
 void MainWindow::on_mShowGridAction_triggered(bool checked)
 {
 	Options::getSingleton().setShowGrid(checked);
+	updateCurrentEditorWindow();
 }
 
 void MainWindow::on_mSnapToGridAction_triggered(bool checked)
 {
 	Options::getSingleton().setSnapToGrid(checked);
+	updateCurrentEditorWindow();
 }
 
 void MainWindow::on_mShowGuidesAction_triggered(bool checked)
 {
 	Options::getSingleton().setShowGuides(checked);
+	updateCurrentEditorWindow();
 }
 
 void MainWindow::on_mSnapToGuidesAction_triggered(bool checked)
 {
 	Options::getSingleton().setSnapToGuides(checked);
+	updateCurrentEditorWindow();
 }
 
 void MainWindow::on_mEnableSmartGuidesAction_triggered(bool checked)
 {
 	Options::getSingleton().setEnableSmartGuides(checked);
+	updateCurrentEditorWindow();
 }
 
 void MainWindow::on_mBringToFrontAction_triggered()
@@ -617,6 +581,9 @@ bool MainWindow::on_mTabWidget_tabCloseRequested(int index)
 				mTranslationFilesWatcher->removePath(translationFileName);
 		}
 
+		// удаляем файл восстановления сцены
+		removeRecoveryFile(editorWindow);
+
 		// удаляем вкладку и окно редактора
 		mTabWidget->removeTab(index);
 		delete editorWindow;
@@ -633,8 +600,11 @@ void MainWindow::on_mTabWidget_currentChanged(int index)
 
 	if (index != -1)
 	{
-		// вызываем обработчик изменения масштаба
+		// переключаем сцену на текущий язык, если он сменился, пока вкладка была в фоне
 		EditorWindow *editorWindow = getCurrentEditorWindow();
+		editorWindow->updateCurrentLanguage();
+
+		// вызываем обработчик изменения масштаба
 		QString zoomStr = QString::number(qRound(editorWindow->getZoom() * 100.0)) + '%';
 		onZoomChanged(zoomStr);
 
@@ -722,15 +692,14 @@ void MainWindow::onLanguageChanged(const QString &language)
 	// сброс фокуса в окне свойств
 	mPropertyWindow->clearChildWidgetFocus();
 
-	// устанавливаем текущий язык
+	// устанавливаем текущий язык; фоновые вкладки переключатся на него при показе
 	Project::getSingleton().setCurrentLanguage(language);
-	for (int i = 0; i < mTabWidget->count(); ++i)
-		getEditorWindow(i)->setCurrentLanguage(language);
 
-	// обновляем окна слоев и свойств
+	// переключаем текущую вкладку и обновляем окна слоев и свойств
 	EditorWindow *editorWindow = getCurrentEditorWindow();
 	if (editorWindow != NULL)
 	{
+		editorWindow->updateCurrentLanguage();
 		mLayersWindow->setCurrentScene(editorWindow->getScene(), !editorWindow->isUntitled() ? editorWindow->getFileName() : "");
 		mPropertyWindow->onEditorWindowSelectionChanged(editorWindow->getSelectedObjects(), editorWindow->getRotationCenter());
 	}
@@ -750,6 +719,7 @@ void MainWindow::onTranslationFileChanged(const QString &path)
 void MainWindow::onSceneChanged(const QString &commandName)
 {
 	getCurrentEditorWindow()->pushCommand(commandName);
+	getCurrentEditorWindow()->invalidate();
 	updateUndoRedoActions();
 }
 
@@ -777,12 +747,15 @@ void MainWindow::onEditorWindowUndoCommandChanged()
 	EditorWindow *editorWindow = getCurrentEditorWindow();
 	editorWindow->deselectAll();
 
-	// перезагружаем файл переводов
-	if (!editorWindow->isUntitled())
-		editorWindow->loadTranslationFile(getTranslationFileName(editorWindow->getFileName()));
+	// перезагружаем переводы только для созданных или перезагруженных объектов
+	Scene *scene = editorWindow->getScene();
+	QList<GameObject *> objects = scene->getRestoredGameObjects();
+	if (!editorWindow->isUntitled() && !objects.empty())
+		editorWindow->loadTranslationFile(getTranslationFileName(editorWindow->getFileName()), objects);
 
-	// обновляем окно слоев и главное меню
-	mLayersWindow->setCurrentScene(editorWindow->getScene(), !editorWindow->isUntitled() ? editorWindow->getFileName() : "");
+	// обновляем окно слоев, если изменились слои, и главное меню
+	if (scene->isLayerTreeRestored())
+		mLayersWindow->setCurrentScene(scene, !editorWindow->isUntitled() ? editorWindow->getFileName() : "");
 	updateUndoRedoActions();
 }
 
@@ -801,16 +774,18 @@ void MainWindow::onPropertyWindowAllowedEditorActionsChanged()
 	getCurrentEditorWindow()->updateAllowedEditorActions();
 }
 
-void MainWindow::onTextureChanged(const QString &fileName, const QSharedPointer<Texture> &texture)
+void MainWindow::onTexturesChanged(const TextureManager::TextureMap &textures)
 {
-	// заменяем текстуру во всех открытых вкладках
+	// заменяем текстуры во всех открытых вкладках
+	EditorWindow *currentEditorWindow = getCurrentEditorWindow();
+	bool currentChanged = false;
 	for (int i = 0; i < mTabWidget->count(); ++i)
-		getEditorWindow(i)->changeTexture(fileName, texture);
+		if (getEditorWindow(i)->changeTextures(textures) && getEditorWindow(i) == currentEditorWindow)
+			currentChanged = true;
 
-	// обновляем окно свойств
-	EditorWindow *editorWindow = getCurrentEditorWindow();
-	if (editorWindow != NULL)
-		mPropertyWindow->onEditorWindowSelectionChanged(editorWindow->getSelectedObjects(), editorWindow->getRotationCenter());
+	// обновляем окно свойств, только если изменились объекты текущей вкладки
+	if (currentChanged)
+		mPropertyWindow->onEditorWindowSelectionChanged(currentEditorWindow->getSelectedObjects(), currentEditorWindow->getRotationCenter());
 }
 
 void MainWindow::onClipboardDataChanged()
@@ -820,6 +795,227 @@ void MainWindow::onClipboardDataChanged()
 		mPasteAction->setEnabled(QApplication::clipboard()->mimeData()->hasFormat("application/x-gameobject"));
 }
 
+void MainWindow::openFile(const QString &fileName)
+{
+	if (!Utils::isFileNameValid(fileName, Project::getSingleton().getRootDirectory() + Project::getSingleton().getScenesDirectory(), this))
+		return;
+
+	// сохраняем каталог с выбранным файлом
+	Options::getSingleton().setLastOpenedDirectory(QFileInfo(fileName).path());
+
+	// проверяем, не открыт ли уже этот файл
+	for (int i = 0; i < mTabWidget->count(); ++i)
+		if (getEditorWindow(i)->getFileName() == fileName)
+		{
+			mTabWidget->setCurrentIndex(i);
+			updateRecentFilesActions(fileName);
+			return;
+		}
+
+	// проверяем, не разбирается ли уже этот файл
+	if (mParsingFiles.contains(fileName))
+		return;
+
+	// запускаем разбор сцены
+	parseFile(fileName);
+}
+
+void MainWindow::parseFile(const QString &fileName)
+{
+	// запускаем выполнение Lua скрипта и разбор сцены в пуле рабочих потоков
+	QFutureWatcher<QByteArray> *watcher = new QFutureWatcher<QByteArray>(this);
+	connect(watcher, SIGNAL(finished()), this, SLOT(onSceneParsed()));
+	watcher->setFuture(QtConcurrent::run(&Scene::parse, fileName));
+	mParsingFiles.insert(fileName, watcher);
+}
+
+void MainWindow::waitForWorkers()
+{
+	// задачи QtConcurrent::run нельзя отменить, поэтому дожидаемся их и удаляем наблюдателей до доставки их сигналов
+	foreach (QFutureWatcher<QByteArray> *watcher, mParsingFiles)
+	{
+		watcher->disconnect(this);
+		watcher->waitForFinished();
+		delete watcher;
+	}
+	mParsingFiles.clear();
+
+	foreach (QFutureWatcher<bool> *watcher, mAutosavingScenes)
+		watcher->waitForFinished();
+}
+
+void MainWindow::reportParseErrors()
+{
+	// показываем ошибки после завершения разбора всех сцен; ошибки, возникшие, пока сообщение открыто, показываем следующим
+	if (mReportingParseErrors)
+		return;
+
+	mReportingParseErrors = true;
+	while (!mParseErrors.empty() && mParsingFiles.empty())
+	{
+		QStringList errors = mParseErrors;
+		mParseErrors.clear();
+		QMessageBox::critical(this, "", errors.join("\n"));
+	}
+	mReportingParseErrors = false;
+}
+
+void MainWindow::onSceneParsed()
+{
+	// получаем результат разбора сцены
+	QFutureWatcher<QByteArray> *watcher = static_cast<QFutureWatcher<QByteArray> *>(sender());
+	QString fileName = mParsingFiles.key(watcher);
+	QString parsedFileName = fileName;
+	QByteArray data = watcher->result();
+	mParsingFiles.remove(fileName);
+	watcher->deleteLater();
+
+	// для файла восстановления получаем имя исходного файла сцены, безымянной сцене даем новое имя
+	QString recoveryFileName;
+	bool untitled = false;
+	if (mRecoveringFiles.contains(fileName))
+	{
+		recoveryFileName = fileName;
+		fileName = mRecoveringFiles.take(recoveryFileName);
+		untitled = fileName.isEmpty();
+		if (untitled)
+			fileName = generateUntitledFileName();
+	}
+
+	// создаем новую вкладку с окном редактора
+	EditorWindow *editorWindow = createEditorWindow(fileName);
+
+	// создаем объекты сцены и загружаем их текстуры и шрифты в главном потоке
+	bool loaded = !data.isEmpty() && (recoveryFileName.isEmpty() ? editorWindow->load(fileName, data) : editorWindow->recover(fileName, untitled, data));
+	if (!loaded)
+	{
+		delete editorWindow;
+		on_mTabWidget_currentChanged(mTabWidget->currentIndex());
+
+		// если данные могли быть прочитаны из испорченного кэша, удаляем его и разбираем Lua скрипт заново
+		if (Scene::removeCache(parsedFileName))
+		{
+			if (!recoveryFileName.isEmpty())
+				mRecoveringFiles.insert(recoveryFileName, untitled ? QString() : fileName);
+			parseFile(parsedFileName);
+			return;
+		}
+
+		if (recoveryFileName.isEmpty())
+		{
+			mParseErrors.push_back("Ошибка открытия файла " + fileName);
+		}
+		else
+		{
+			QFile::remove(recoveryFileName);
+			mParseErrors.push_back("Ошибка восстановления файла " + fileName);
+		}
+		reportParseErrors();
+		return;
+	}
+
+	// загружаем файл переводов и добавляем его на слежение
+	if (!untitled)
+	{
+		QString translationFileName = getTranslationFileName(fileName);
+		editorWindow->loadTranslationFile(translationFileName);
+		mTranslationFilesMap.insert(translationFileName, TranslationFileInfo(editorWindow));
+		if (!mTranslationFilesWatcher->files().contains(translationFileName) && Utils::fileExists(translationFileName))
+			mTranslationFilesWatcher->addPath(translationFileName);
+	}
+
+	// создаем новую вкладку и переключаемся на нее
+	mTabWidget->addTab(editorWindow, QFileInfo(fileName).fileName());
+	mTabWidget->setCurrentWidget(editorWindow);
+	onClipboardDataChanged();
+
+	// обновляем список последних файлов, а восстановленная сцена продолжает использовать свой файл восстановления
+	if (recoveryFileName.isEmpty())
+	{
+		updateRecentFilesActions(fileName);
+	}
+	else
+	{
+		mRecoveryFiles.insert(editorWindow, recoveryFileName);
+		saveRecoveryList();
+		updateUndoRedoActions();
+	}
+
+	// проверяем сцену на наличие отсутствующих файлов
+	checkMissedFiles();
+}
+
+void MainWindow::onAutosaveTimeout()
+{
+	// сохраняем копии измененных сцен; в главном потоке создается только снимок записей состояния из истории отмен,
+	// а пересоздание объектов и запись Lua скрипта выполняются в пуле рабочих потоков
+	for (int i = 0; i < mTabWidget->count(); ++i)
+	{
+		EditorWindow *editorWindow = getEditorWindow(i);
+		if (editorWindow->isClean() || mAutosavingScenes.contains(editorWindow))
+			continue;
+
+		// назначаем окну редактирования файл восстановления при первом автосохранении
+		QString &recoveryFileName = mRecoveryFiles[editorWindow];
+		if (recoveryFileName.isEmpty())
+			recoveryFileName = getRecoveryDirectory() + QString("%1_%2.lua").arg(QCoreApplication::applicationPid()).arg(mRecoveryIndex++);
+
+		// запускаем сохранение снимка сцены
+		QFutureWatcher<bool> *watcher = new QFutureWatcher<bool>(this);
+		connect(watcher, SIGNAL(finished()), this, SLOT(onSceneAutosaved()));
+		watcher->setFuture(QtConcurrent::run(&Scene::saveSnapshot, editorWindow->getScene()->createSnapshot(), recoveryFileName));
+		mAutosavingScenes.insert(editorWindow, watcher);
+	}
+}
+
+void MainWindow::onSceneAutosaved()
+{
+	// получаем результат автосохранения сцены
+	QFutureWatcher<bool> *watcher = static_cast<QFutureWatcher<bool> *>(sender());
+	mAutosavingScenes.remove(mAutosavingScenes.key(watcher));
+	watcher->deleteLater();
+
+	// запоминаем записанный файл восстановления в настройках, чтобы предложить восстановление при следующем запуске
+	if (watcher->result())
+		saveRecoveryList();
+}
+
+void MainWindow::restoreRecoveryFiles()
+{
+	// читаем список файлов восстановления, оставшихся после аварийного завершения, и очищаем его в настройках
+	QSettings settings;
+	QMap<QString, QString> recoveryFiles;
+	int size = settings.beginReadArray("Recovery");
+	for (int i = 0; i < size; ++i)
+	{
+		settings.setArrayIndex(i);
+		QString recoveryFileName = settings.value("RecoveryFileName").toString();
+		if (QFile::exists(recoveryFileName))
+			recoveryFiles.insert(recoveryFileName, settings.value("FileName").toString());
+	}
+	settings.endArray();
+	settings.remove("Recovery");
+	if (recoveryFiles.isEmpty())
+		return;
+
+	// предлагаем восстановить сцены, при отказе удаляем файлы восстановления
+	QString text = QString("Работа редактора была завершена аварийно. Восстановить несохраненные сцены (%1)?").arg(recoveryFiles.size());
+	if (QMessageBox::question(this, "", text, QMessageBox::Yes | QMessageBox::No) != QMessageBox::Yes)
+	{
+		foreach (const QString &recoveryFileName, recoveryFiles.keys())
+			QFile::remove(recoveryFileName);
+		return;
+	}
+
+	// запускаем разбор файлов восстановления в пуле рабочих потоков
+	for (QMap<QString, QString>::const_iterator it = recoveryFiles.begin(); it != recoveryFiles.end(); ++it)
+	{
+		mRecoveringFiles.insert(it.key(), *it);
+		parseFile(it.key());
+	}
+	saveRecoveryList();
+}
+
 EditorWindow *MainWindow::createEditorWindow(const QString &fileName)
 {
 	// создаем новое окно редактора
@@ -856,6 +1052,73 @@ EditorWindow *MainWindow::createEditorWindow(const QString &fileName)
 	return editorWindow;
 }
 
+QString MainWindow::generateUntitledFileName()
+{
+	QString fileName = mUntitledIndex == 1 ? "untitled.lua" : QString("untitled_%1.lua").arg(mUntitledIndex);
+	++mUntitledIndex;
+	return fileName;
+}
+
+void MainWindow::updateAutosaveTimer()
+{
+	// запускаем таймер автосохранения или останавливаем его, если автосохранение отключено
+	int interval = Options::getSingleton().getAutosaveInterval();
+	if (interval > 0)
+		mAutosaveTimer->start(interval * 60000);
+	else
+		mAutosaveTimer->stop();
+}
+
+QString MainWindow::getRecoveryDirectory() const
+{
+	QString path = QDesktopServices::storageLocation(QDesktopServices::DataLocation) + "/recovery/";
+	QDir().mkpath(path);
+	return path;
+}
+
+void MainWindow::removeRecoveryFile(EditorWindow *editorWindow)
+{
+	// дожидаемся завершения автосохранения, чтобы рабочий поток не записал файл восстановления заново
+	QFutureWatcher<bool> *watcher = mAutosavingScenes.take(editorWindow);
+	if (watcher != NULL)
+	{
+		watcher->waitForFinished();
+		delete watcher;
+	}
+
+	// удаляем файл восстановления и обновляем список в настройках
+	QString recoveryFileName = mRecoveryFiles.take(editorWindow);
+	if (!recoveryFileName.isEmpty())
+	{
+		QFile::remove(recoveryFileName);
+		saveRecoveryList();
+	}
+}
+
+void MainWindow::saveRecoveryList()
+{
+	// сохраняем пары имен файлов сцен и файлов восстановления, безымянным сценам соответствует пустое имя
+	QSettings settings;
+	settings.remove("Recovery");
+	settings.beginWriteArray("Recovery", mRecoveryFiles.size() + mRecoveringFiles.size());
+	int index = 0;
+	for (QMap<EditorWindow *, QString>::const_iterator it = mRecoveryFiles.begin(); it != mRecoveryFiles.end(); ++it)
+	{
+		settings.setArrayIndex(index++);
+		settings.setValue("FileName", it.key()->isUntitled() ? QString() : it.key()->getFileName());
+		settings.setValue("RecoveryFileName", *it);
+	}
+
+	// файлы восстановления, разбор которых еще не завершен, будут предложены к восстановлению снова
+	for (QMap<QString, QString>::const_iterator it = mRecoveringFiles.begin(); it != mRecoveringFiles.end(); ++it)
+	{
+		settings.setArrayIndex(index++);
+		settings.setValue("FileName", *it);
+		settings.setValue("RecoveryFileName", it.key());
+	}
+	settings.endArray();
+}
+
 QString MainWindow::getTranslationFileName(const QString &fileName) const
 {
 	Project &project = Project::getSingleton();
@@ -918,6 +1181,9 @@ void MainWindow::updateUndoRedoActions()
 	mSaveAction->setEnabled(!clean);
 	mUndoAction->setEnabled(editorWindow->canUndo());
 	mRedoAction->setEnabled(editorWindow->canRedo());
+
+	// обновляем объем памяти, занимаемый историей отмен
+	mHistoryWindow->setUndoMemoryUsage(editorWindow->getUndoMemoryUsage());
 }
 
 void MainWindow::checkMissedFiles()
@@ -939,6 +1205,13 @@ void MainWindow::checkMissedFiles()
 	}
 }
 
+void MainWindow::updateCurrentEditorWindow()
+{
+	EditorWindow *editorWindow = getCurrentEditorWindow();
+	if (editorWindow != NULL)
+		editorWindow->invalidate();
+}
+
 MainWindow::PercentIntValidator::PercentIntValidator(int bottom, int top, MainWindow *parent)
 : QIntValidator(bottom, top, parent), mParent(parent)
 {
@@ -0,0 +1,154 @@
+#include "pch.h"
+#include "name_index.h"
+
+const QString NameIndex::COPY_SUFFIX = QString::fromUtf8(" копия");
+
+NameIndex::NameIndex()
+{
+}
+
+void NameIndex::insert(const QString &name, GameObject *object)
+{
+	// добавляем объект и учитываем номер копии, если имя записано так же, как его составляет joinName
+	mObjects.insert(name, object);
+	QString baseName;
+	int index;
+	splitName(name, baseName, index);
+	if (joinName(baseName, index) == name)
+		addCopyIndex(baseName, index);
+}
+
+void NameIndex::remove(const QString &name, GameObject *object)
+{
+	// удаляем объект, выходим, если его не было в индексе
+	if (mObjects.remove(name, object) == 0)
+		return;
+
+	QString baseName;
+	int index;
+	splitName(name, baseName, index);
+	if (joinName(baseName, index) == name)
+		removeCopyIndex(baseName, index);
+}
+
+void NameIndex::takeFrom(NameIndex &index)
+{
+	// пустой индекс просто разделяет данные другого индекса, иначе переносим записи по одной
+	if (mObjects.isEmpty())
+	{
+		mObjects = index.mObjects;
+		mCopyIndices = index.mCopyIndices;
+	}
+	else
+	{
+		for (QMultiHash<QString, GameObject *>::const_iterator it = index.mObjects.constBegin(); it != index.mObjects.constEnd(); ++it)
+			insert(it.key(), it.value());
+	}
+
+	index.mObjects.clear();
+	index.mCopyIndices.clear();
+}
+
+QList<GameObject *> NameIndex::findAll(const QString &name) const
+{
+	return mObjects.values(name);
+}
+
+int NameIndex::findFreeCopyIndex(const QString &baseName, int index) const
+{
+	// находим диапазон занятых номеров, начинающийся не позже заданного номера
+	QHash<QString, CopyIndices>::const_iterator it = mCopyIndices.find(baseName);
+	if (it == mCopyIndices.end())
+		return index;
+	QMap<int, int>::const_iterator rangeIt = it->mRanges.upperBound(index);
+	if (rangeIt == it->mRanges.begin())
+		return index;
+
+	// диапазоны не соприкасаются, поэтому номер после диапазона, содержащего заданный номер, свободен
+	--rangeIt;
+	return rangeIt.value() >= index ? rangeIt.value() + 1 : index;
+}
+
+void NameIndex::splitName(const QString &name, QString &baseName, int &index)
+{
+	// имя вида "<база> копия N", где N >= 2
+	int pos = name.lastIndexOf(COPY_SUFFIX + ' ');
+	if (pos != -1)
+	{
+		QString number = name.mid(pos + COPY_SUFFIX.size() + 1);
+		bool digits = !number.isEmpty();
+		for (int i = 0; i < number.size() && digits; ++i)
+			digits = number[i].isDigit();
+		int copyIndex = digits ? number.toInt() : 0;
+		if (copyIndex >= 2)
+		{
+			baseName = name.left(pos);
+			index = copyIndex;
+			return;
+		}
+	}
+
+	// имя вида "<база> копия"
+	if (name.endsWith(COPY_SUFFIX))
+	{
+		baseName = name.left(name.size() - COPY_SUFFIX.size());
+		index = 1;
+		return;
+	}
+
+	// имя без номера копии
+	baseName = name;
+	index = 0;
+}
+
+QString NameIndex::joinName(const QString &baseName, int index)
+{
+	if (index == 0)
+		return baseName;
+	return baseName + COPY_SUFFIX + (index > 1 ? " " + QString::number(index) : "");
+}
+
+void NameIndex::addCopyIndex(const QString &baseName, int index)
+{
+	// увеличиваем количество имен с номером копии, выходим, если номер уже был занят
+	CopyIndices &indices = mCopyIndices[baseName];
+	if (indices.mCounts[index]++ != 0)
+		return;
+
+	// объединяем номер с соседними диапазонами занятых номеров
+	int first = index, last = index;
+	QMap<int, int>::iterator it = indices.mRanges.lowerBound(index);
+	if (it != indices.mRanges.end() && it.key() == index + 1)
+	{
+		last = it.value();
+		it = indices.mRanges.erase(it);
+	}
+	if (it != indices.mRanges.begin() && (it - 1).value() == index - 1)
+		first = (it - 1).key();
+	indices.mRanges.insert(first, last);
+}
+
+void NameIndex::removeCopyIndex(const QString &baseName, int index)
+{
+	// уменьшаем количество имен с номером копии, выходим, если номер остался занят
+	QHash<QString, CopyIndices>::iterator it = mCopyIndices.find(baseName);
+	if (it == mCopyIndices.end())
+		return;
+	QMap<int, int>::iterator countIt = it->mCounts.find(index);
+	if (countIt == it->mCounts.end() || --*countIt != 0)
+		return;
+	it->mCounts.erase(countIt);
+
+	// разбиваем диапазон, содержащий освободившийся номер
+	QMap<int, int>::iterator rangeIt = it->mRanges.upperBound(index) - 1;
+	int first = rangeIt.key(), last = rangeIt.value();
+	it->mRanges.erase(rangeIt);
+	if (first < index)
+		it->mRanges.insert(first, index - 1);
+	if (last > index)
+		it->mRanges.insert(index + 1, last);
+
+	// удаляем пустые записи
+	if (it->mCounts.isEmpty())
+		mCopyIndices.erase(it);
+}
@@ -28,6 +28,15 @@ Options::Options(QSettings &settings)
 	mSnapToGuides = settings.value("SnapToGuides", true).toBool();
 	mEnableSmartGuides = settings.value("EnableSmartGuides", true).toBool();
 	settings.endGroup();
+
+	// загружаем настройки редактора
+	settings.beginGroup("Editor");
+	mMaxDragFrameRate = settings.value("MaxDragFrameRate", 60).toInt();
+	mUndoMemoryLimit = settings.value("UndoMemoryLimit", 256).toInt();
+	mAutosaveInterval = settings.value("AutosaveInterval", 5).toInt();
+	mFontCacheSize = settings.value("FontCacheSize", 16).toInt();
+	mFontCacheTimeout = settings.value("FontCacheTimeout", 60).toInt();
+	settings.endGroup();
 }
 
 void Options::save(QSettings &settings)
@@ -54,6 +63,15 @@ void Options::save(QSettings &settings)
 	settings.setValue("SnapToGuides", mSnapToGuides);
 	settings.setValue("EnableSmartGuides", mEnableSmartGuides);
 	settings.endGroup();
+
+	// сохраняем настройки редактора
+	settings.beginGroup("Editor");
+	settings.setValue("MaxDragFrameRate", mMaxDragFrameRate);
+	settings.setValue("UndoMemoryLimit", mUndoMemoryLimit);
+	settings.setValue("AutosaveInterval", mAutosaveInterval);
+	settings.setValue("FontCacheSize", mFontCacheSize);
+	settings.setValue("FontCacheTimeout", mFontCacheTimeout);
+	settings.endGroup();
 }
 
 QString Options::getLastOpenedDirectory() const
@@ -165,3 +183,53 @@ void Options::setEnableSmartGuides(bool enableSmartGuides)
 {
 	mEnableSmartGuides = enableSmartGuides;
 }
+
+int Options::getMaxDragFrameRate() const
+{
+	return mMaxDragFrameRate;
+}
+
+void Options::setMaxDragFrameRate(int maxDragFrameRate)
+{
+	mMaxDragFrameRate = maxDragFrameRate;
+}
+
+int Options::getUndoMemoryLimit() const
+{
+	return mUndoMemoryLimit;
+}
+
+void Options::setUndoMemoryLimit(int undoMemoryLimit)
+{
+	mUndoMemoryLimit = undoMemoryLimit;
+}
+
+int Options::getAutosaveInterval() const
+{
+	return mAutosaveInterval;
+}
+
+void Options::setAutosaveInterval(int autosaveInterval)
+{
+	mAutosaveInterval = autosaveInterval;
+}
+
+int Options::getFontCacheSize() const
+{
+	return mFontCacheSize;
+}
+
+void Options::setFontCacheSize(int fontCacheSize)
+{
+	mFontCacheSize = fontCacheSize;
+}
+
+int Options::getFontCacheTimeout() const
+{
+	return mFontCacheTimeout;
+}
+
+void Options::setFontCacheTimeout(int fontCacheTimeout)
+{
+	mFontCacheTimeout = fontCacheTimeout;
+}
@@ -20,6 +20,13 @@ OptionsDialog::OptionsDialog(QWidget *parent)
 	mSnapToGuidesCheckBox->setChecked(options.isSnapToGuides());
 	mEnableSmartGuidesCheckBox->setChecked(options.isEnableSmartGuides());
 
+	// получаем настройки редактора
+	mMaxDragFrameRateSpinBox->setValue(options.getMaxDragFrameRate());
+	mUndoMemoryLimitSpinBox->setValue(options.getUndoMemoryLimit());
+	mAutosaveIntervalSpinBox->setValue(options.getAutosaveInterval());
+	mFontCacheSizeSpinBox->setValue(options.getFontCacheSize());
+	mFontCacheTimeoutSpinBox->setValue(options.getFontCacheTimeout());
+
 	// устанавливаем фиксированный размер для диалогового окна
 	setVisible(true);
 	setFixedSize(size());
@@ -52,6 +59,13 @@ void OptionsDialog::applySettings()
 	options.setSnapToGuides(mSnapToGuidesCheckBox->isChecked());
 	options.setEnableSmartGuides(mEnableSmartGuidesCheckBox->isChecked());
 
+	// устанавливаем настройки редактора
+	options.setMaxDragFrameRate(mMaxDragFrameRateSpinBox->value());
+	options.setUndoMemoryLimit(mUndoMemoryLimitSpinBox->value());
+	options.setAutosaveInterval(mAutosaveIntervalSpinBox->value());
+	options.setFontCacheSize(mFontCacheSizeSpinBox->value());
+	options.setFontCacheTimeout(mFontCacheTimeoutSpinBox->value());
+
 	// сохраняем настройки в конфигурационный файл
 	QSettings settings;
 	options.save(settings);
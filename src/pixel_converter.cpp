@@ -0,0 +1,115 @@
+#include "pch.h"
+#include "pixel_converter.h"
+
+// SSE2 доступен на всех x86-64 процессорах, AVX2 используется, только если включен при компиляции
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define PIXEL_CONVERTER_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(PIXEL_CONVERTER_SSE2) && defined(__AVX2__)
+#define PIXEL_CONVERTER_AVX2
+#include <immintrin.h>
+#endif
+
+void PixelConverter::convertToRGBA(const quint32 *src, quint32 *dst, int count, bool opaque, bool premultiply)
+{
+	// у непрозрачных пикселей умножение на альфу ничего не меняет
+	premultiply = premultiply && !opaque;
+	int i = 0;
+
+#ifdef PIXEL_CONVERTER_AVX2
+	{
+		// переставляем байты BGRA в RGBA внутри каждого пикселя
+		const __m256i swizzle = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+			2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+		const __m256i alphaMask = _mm256_set1_epi32(opaque ? 0xFF000000 : 0);
+		const __m256i alphaLanes = _mm256_set1_epi64x(0x00FF000000000000LL);
+		const __m256i round = _mm256_set1_epi16(128);
+		const __m256i zero = _mm256_setzero_si256();
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+			pixels = _mm256_or_si256(_mm256_shuffle_epi8(pixels, swizzle), alphaMask);
+			if (premultiply)
+			{
+				// умножаем каналы на альфу в 16-битных словах, альфу умножаем на 255, чтобы она не изменилась
+				__m256i lo = _mm256_unpacklo_epi8(pixels, zero);
+				__m256i hi = _mm256_unpackhi_epi8(pixels, zero);
+				__m256i alphaLo = _mm256_or_si256(_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo, 0xFF), 0xFF), alphaLanes);
+				__m256i alphaHi = _mm256_or_si256(_mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi, 0xFF), 0xFF), alphaLanes);
+				lo = _mm256_add_epi16(_mm256_mullo_epi16(lo, alphaLo), round);
+				hi = _mm256_add_epi16(_mm256_mullo_epi16(hi, alphaHi), round);
+				lo = _mm256_srli_epi16(_mm256_add_epi16(lo, _mm256_srli_epi16(lo, 8)), 8);
+				hi = _mm256_srli_epi16(_mm256_add_epi16(hi, _mm256_srli_epi16(hi, 8)), 8);
+				pixels = _mm256_packus_epi16(lo, hi);
+			}
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), pixels);
+		}
+	}
+#endif
+
+#ifdef PIXEL_CONVERTER_SSE2
+	{
+		// меняем местами байты R и B, обменивая 16-битные половины каждого пикселя в маске R и B
+		const __m128i agMask = _mm_set1_epi32(0xFF00FF00);
+		const __m128i rbMask = _mm_set1_epi32(0x00FF00FF);
+		const __m128i alphaMask = _mm_set1_epi32(opaque ? 0xFF000000 : 0);
+		const __m128i alphaLanes = _mm_set_epi16(0xFF, 0, 0, 0, 0xFF, 0, 0, 0);
+		const __m128i round = _mm_set1_epi16(128);
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+			__m128i rb = _mm_and_si128(pixels, rbMask);
+			rb = _mm_shufflehi_epi16(_mm_shufflelo_epi16(rb, _MM_SHUFFLE(2, 3, 0, 1)), _MM_SHUFFLE(2, 3, 0, 1));
+			pixels = _mm_or_si128(_mm_or_si128(_mm_and_si128(pixels, agMask), rb), alphaMask);
+			if (premultiply)
+			{
+				// умножаем каналы на альфу в 16-битных словах, альфу умножаем на 255, чтобы она не изменилась
+				__m128i lo = _mm_unpacklo_epi8(pixels, zero);
+				__m128i hi = _mm_unpackhi_epi8(pixels, zero);
+				__m128i alphaLo = _mm_or_si128(_mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF), alphaLanes);
+				__m128i alphaHi = _mm_or_si128(_mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF), alphaLanes);
+				lo = _mm_add_epi16(_mm_mullo_epi16(lo, alphaLo), round);
+				hi = _mm_add_epi16(_mm_mullo_epi16(hi, alphaHi), round);
+				lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+				hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+				pixels = _mm_packus_epi16(lo, hi);
+			}
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), pixels);
+		}
+	}
+#endif
+
+	// обрабатываем оставшиеся пиксели
+	convertScalar(src + i, dst + i, count - i, opaque, premultiply);
+}
+
+void PixelConverter::convertScalar(const quint32 *src, quint32 *dst, int count, bool opaque, bool premultiply)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		quint32 pixel = src[i];
+		if (opaque)
+			pixel |= 0xFF000000;
+
+		// умножаем цвета на альфу с округлением
+		if (premultiply)
+		{
+			quint32 alpha = pixel >> 24;
+			quint32 rb = (pixel & 0x00FF00FF) * alpha + 0x00800080;
+			quint32 g = ((pixel >> 8) & 0xFF) * alpha + 0x80;
+			rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+			g = ((g + (g >> 8)) >> 8) & 0xFF;
+			pixel = (alpha << 24) | (g << 8) | rb;
+		}
+
+		// раскладываем значение 0xAARRGGBB в байты R, G, B, A
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+		dst[i] = (pixel & 0xFF00FF00) | ((pixel >> 16) & 0xFF) | ((pixel & 0xFF) << 16);
+#else
+		dst[i] = (pixel << 8) | (pixel >> 24);
+#endif
+	}
+}
@@ -6,6 +6,7 @@
 template<> Project *Singleton<Project>::mSingleton = NULL;
 
 Project::Project()
+: mLanguageVersion(0)
 {
 	close();
 }
@@ -22,6 +23,8 @@ bool Project::open(const QString &fileName)
 		return false;
 	}
 
+	// регистрируем языки проекта
+	registerLanguages();
 	return true;
 }
 
@@ -39,6 +42,7 @@ void Project::close()
 	mLanguages = QStringList("en");
 	mLanguageNames = QStringList("&Английский");
 	mDefaultLanguage = mCurrentLanguage = "en";
+	registerLanguages();
 }
 
 bool Project::isOpen() const
@@ -104,6 +108,49 @@ QString Project::getCurrentLanguage() const
 void Project::setCurrentLanguage(const QString &language)
 {
 	mCurrentLanguage = language;
+	mCurrentLanguageId = getLanguageId(language);
+	++mLanguageVersion;
+}
+
+int Project::getLanguageId(const QString &language)
+{
+	// ищем уже зарегистрированный код языка
+	{
+		QReadLocker locker(&mLanguageIdsLock);
+		QHash<QString, int>::const_iterator it = mLanguageIds.find(language);
+		if (it != mLanguageIds.end())
+			return *it;
+	}
+
+	// регистрируем новый код, повторно проверяя его наличие под блокировкой записи
+	QWriteLocker locker(&mLanguageIdsLock);
+	QHash<QString, int>::const_iterator it = mLanguageIds.find(language);
+	if (it != mLanguageIds.end())
+		return *it;
+	mLanguageIds.insert(language, mLanguageCodes.size());
+	mLanguageCodes.push_back(language);
+	return mLanguageCodes.size() - 1;
+}
+
+QString Project::getLanguageCode(int id) const
+{
+	QReadLocker locker(&mLanguageIdsLock);
+	return mLanguageCodes.value(id);
+}
+
+int Project::getDefaultLanguageId() const
+{
+	return mDefaultLanguageId;
+}
+
+int Project::getCurrentLanguageId() const
+{
+	return mCurrentLanguageId;
+}
+
+int Project::getLanguageVersion() const
+{
+	return mLanguageVersion;
 }
 
 bool Project::loadProjectFile(const QString &fileName)
@@ -219,3 +266,16 @@ bool Project::saveProjectFile(const QString &fileName)
 
 	return stream.status() == QTextStream::Ok;
 }
+
+void Project::registerLanguages()
+{
+	// идентификаторы языков проекта совпадают с их индексами в списке языков
+	QWriteLocker locker(&mLanguageIdsLock);
+	mLanguageCodes = mLanguages;
+	mLanguageIds.clear();
+	for (int i = 0; i < mLanguageCodes.size(); ++i)
+		mLanguageIds.insert(mLanguageCodes[i], i);
+	mDefaultLanguageId = mLanguageIds.value(mDefaultLanguage);
+	mCurrentLanguageId = mLanguageIds.value(mCurrentLanguage);
+	++mLanguageVersion;
+}
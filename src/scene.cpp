@@ -4,11 +4,13 @@
 #include "layer.h"
 #include "layer_group.h"
 #include "lua_script.h"
+#include "name_index.h"
+#include "options.h"
 #include "sprite.h"
 #include "utils.h"
 
 Scene::Scene(QObject *parent)
-: QObject(parent), mCommandIndex(0), mObjectIndex(1), mLayerIndex(1), mLayerGroupIndex(1), mSpriteIndex(1), mLabelIndex(1)
+: QObject(parent), mCommandIndex(0), mUndoKeyIndex(1), mTrimmingUndoStack(false), mUndoMemoryUsage(0), mLoadResources(true), mLayerTreeRestored(false), mObjectIndex(1), mLayerIndex(1), mLayerGroupIndex(1), mSpriteIndex(1), mLabelIndex(1)
 {
 	// создаем корневой слой
 	mRootLayer = new LayerGroup("");
@@ -22,6 +24,7 @@ Scene::Scene(QObject *parent)
 
 	// сохраняем начальное состояние сцены
 	mInitialState = new UndoCommand("", this);
+	mUndoMemoryUsage = mInitialState->getMemoryUsage();
 }
 
 Scene::~Scene()
@@ -30,13 +33,191 @@ Scene::~Scene()
 	delete mRootLayer;
 }
 
-bool Scene::load(const QString &fileName)
+QByteArray Scene::parse(const QString &fileName)
+{
+	// читаем бинарное представление из кэша, если он не устарел
+	QByteArray data = readCache(fileName);
+	if (!data.isEmpty())
+		return data;
+
+	// иначе выполняем Lua скрипт
+	return parseScript(fileName);
+}
+
+bool Scene::load(const QByteArray &data)
+{
+	// загружаем слои
+	QDataStream stream(data);
+	stream.setVersion(QDataStream::Qt_4_5);
+	QString type;
+	stream >> type;
+	QScopedPointer<BaseLayer> rootLayer(new LayerGroup());
+	if (type != "LayerGroup" || !rootLayer->load(stream))
+		return false;
+
+	// находим активный слой по последовательности индексов
+	QList<int> indices;
+	stream >> indices;
+	BaseLayer *activeLayer = rootLayer.data();
+	foreach (int index, indices)
+	{
+		if (index < 0 || index >= activeLayer->getNumChildLayers())
+			return false;
+		activeLayer = activeLayer->getChildLayer(index);
+	}
+
+	// загружаем счетчики для генерации имен и направляющие
+	int objectIndex, layerIndex, layerGroupIndex, spriteIndex, labelIndex;
+	QList<qreal> horzGuides, vertGuides;
+	stream >> objectIndex >> layerIndex >> layerGroupIndex >> spriteIndex >> labelIndex >> horzGuides >> vertGuides;
+	if (stream.status() != QDataStream::Ok)
+		return false;
+
+	// загружаем ресурсы объектов до сохранения начального состояния, так как они уточняют размеры объектов
+	if (mLoadResources)
+		foreach (GameObject *object, rootLayer->getGameObjects())
+			object->loadResources();
+
+	// заменяем текущую сцену загруженной
+	delete mRootLayer;
+	mRootLayer = rootLayer.take();
+	mActiveLayer = activeLayer;
+	mObjectIndex = objectIndex;
+	mLayerIndex = layerIndex;
+	mLayerGroupIndex = layerGroupIndex;
+	mSpriteIndex = spriteIndex;
+	mLabelIndex = labelIndex;
+	mHorzGuides = horzGuides;
+	mVertGuides = vertGuides;
+
+	// пересохраняем начальное состояние сцены
+	mUndoRecords.clear();
+	mUndoHeader.clear();
+	mUndoMemoryUsage -= mInitialState->getMemoryUsage();
+	delete mInitialState;
+	mInitialState = new UndoCommand("", this);
+	mUndoMemoryUsage += mInitialState->getMemoryUsage();
+	return true;
+}
+
+bool Scene::save(const QString &fileName)
+{
+	// сохраняем Lua скрипт сцены
+	if (!saveScript(fileName))
+		return false;
+
+	// обновляем бинарный кэш сцены, ошибка записи кэша не мешает сохранению
+	if (!saveCache(fileName))
+		removeCache(fileName);
+	return true;
+}
+
+bool Scene::removeCache(const QString &fileName)
+{
+	return QFile::remove(getCacheFileName(fileName));
+}
+
+Scene::Snapshot Scene::createSnapshot() const
+{
+	// записи состояния разделяются с историей отмен и копируются только при последующем изменении сцены
+	Snapshot snapshot;
+	snapshot.mRecords = mUndoRecords;
+	snapshot.mHeader = mUndoHeader;
+	return snapshot;
+}
+
+bool Scene::saveSnapshot(const Snapshot &snapshot, const QString &fileName)
+{
+	// восстанавливаем сцену по записям состояния во временной сцене без загрузки ресурсов объектов
+	Scene scene(NULL);
+	scene.mLoadResources = false;
+	scene.mUndoRecords = snapshot.mRecords;
+	scene.mUndoHeader = snapshot.mHeader;
+	if (!scene.restoreUndoRecords())
+		return false;
+
+	// сохраняем восстановленную сцену в Lua скрипт
+	return scene.saveScript(fileName);
+}
+
+bool Scene::saveScript(const QString &fileName)
+{
+	// засекаем время сохранения
+	QElapsedTimer timer;
+	timer.start();
+
+	// создаем текстовый поток в буфер, заранее выделенный по количеству объектов
+	QString buffer;
+	buffer.reserve(SAVE_BUFFER_BASE_SIZE + mRootLayer->getGameObjects().size() * SAVE_BUFFER_OBJECT_SIZE);
+	QTextStream stream(&buffer, QIODevice::WriteOnly);
+	stream << qSetRealNumberPrecision(8) << uppercasedigits;
+
+	// записываем шапку файла
+	Utils::writeFileHeader(stream);
+
+	// записываем код для возврата корневой таблицы
+	stream << endl << "return" << endl;
+	stream << "{" << endl;
+
+	// сохраняем слои
+	stream << "\t-- Layers table" << endl;
+	stream << "\tlayers =" << endl;
+	mRootLayer->save(stream, 1);
+	stream << "," << endl;
+
+	// сохраняем последовательность индексов, ведущую к активному слою
+	QStringList indices;
+	for (BaseLayer *layer = mActiveLayer; layer != mRootLayer; layer = layer->getParentLayer())
+		indices.push_front(QString::number(layer->getParentLayer()->indexOfChildLayer(layer)));
+	stream << endl << "\t-- Path to the current active layer" << endl;
+	stream << "\tactiveLayer = {" << indices.join(", ") << "}," << endl;
+
+	// сохраняем счетчики для генерации имен
+	stream << endl << "\t-- Counters for generating various object IDs" << endl;
+	stream << "\tobjectIndex = " << mObjectIndex << "," << endl;
+	stream << "\tlayerIndex = " << mLayerIndex << "," << endl;
+	stream << "\tlayerGroupIndex = " << mLayerGroupIndex << "," << endl;
+	stream << "\tspriteIndex = " << mSpriteIndex << "," << endl;
+	stream << "\tlabelIndex = " << mLabelIndex << "," << endl;
+
+	// сохраняем горизонтальные направляющие
+	QStringList horzGuides;
+	foreach (qreal coord, mHorzGuides)
+		horzGuides.push_back(QString::number(coord));
+	stream << endl << "\t-- Coordinates of horizontal and vertical guides" << endl;
+	stream << "\thorzGuides = {" << horzGuides.join(", ") << "}," << endl;
+
+	// сохраняем вертикальные направляющие
+	QStringList vertGuides;
+	foreach (qreal coord, mVertGuides)
+		vertGuides.push_back(QString::number(coord));
+	stream << "\tvertGuides = {" << vertGuides.join(", ") << "}" << endl;
+
+	// записываем закрывающую фигурную скобку корневой таблицы
+	stream << "}" << endl;
+	if (stream.status() != QTextStream::Ok)
+		return false;
+
+	// записываем буфер во временный файл и атомарно заменяем им файл сцены, чтобы сбой не испортил сцену
+	stream.flush();
+	QByteArray data = buffer.toUtf8();
+	if (!Utils::writeFileAtomically(fileName, data))
+		return false;
+
+	qDebug() << "Scene" << fileName << "saved in" << timer.elapsed() << "ms," << data.size() << "bytes";
+	return true;
+}
+
+bool Scene::loadScript(const QString &fileName)
 {
 	// загружаем Lua скрипт и проверяем, что он вернул корневую таблицу
 	LuaScript script;
 	if (!script.load(fileName, 1) || !script.pushTable())
 		return false;
 
+	// регистрируем ключи свойств для загрузки игровых объектов за один обход их таблиц
+	GameObject::registerPropertyKeys(script);
+
 	// пересоздаем корневой слой
 	delete mRootLayer;
 	mRootLayer = new LayerGroup();
@@ -100,84 +281,148 @@ bool Scene::load(const QString &fileName)
 
 	// извлекаем из стека корневую таблицу
 	script.popTable();
+	return true;
+}
 
-	// пересохраняем начальное состояние сцены
-	delete mInitialState;
-	mInitialState = new UndoCommand("", this);
+QByteArray Scene::parseScript(const QString &fileName)
+{
+	// выполняем Lua скрипт во временной сцене и сохраняем ее в бинарное представление;
+	// ресурсы объектов при этом не загружаются, поэтому разбор не требует контекста OpenGL
+	Scene scene(NULL);
+	scene.mLoadResources = false;
+	if (!scene.loadScript(fileName))
+		return QByteArray();
+
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_4_5);
+	if (!scene.saveData(stream))
+		return QByteArray();
+
+	return data;
+}
 
-	return true;
+QString Scene::getCacheFileName(const QString &fileName)
+{
+	return fileName + ".cache";
 }
 
-bool Scene::save(const QString &fileName)
+QByteArray Scene::getFileHash(const QString &fileName)
 {
-	// открываем файл
 	QFile file(fileName);
-	if (!file.open(QIODevice::WriteOnly))
-		return false;
+	if (!file.open(QIODevice::ReadOnly))
+		return QByteArray();
+	return QCryptographicHash::hash(file.readAll(), QCryptographicHash::Md5);
+}
 
-	// создаем текстовый поток
-	QTextStream stream(&file);
-	stream << qSetRealNumberPrecision(8) << uppercasedigits;
+QByteArray Scene::readCache(const QString &fileName)
+{
+	// читаем заголовок кэша
+	QFile file(getCacheFileName(fileName));
+	if (!file.open(QIODevice::ReadOnly))
+		return QByteArray();
+	QDataStream stream(&file);
+	stream.setVersion(QDataStream::Qt_4_5);
+	quint32 magic, version, dataSize;
+	uint modificationTime;
+	stream >> magic >> version >> modificationTime;
+	if (stream.status() != QDataStream::Ok || magic != CACHE_MAGIC || version != CACHE_VERSION)
+		return QByteArray();
+
+	// сравниваем время изменения файла сцены до вычисления хеша, чтобы не читать файл сцены, если кэш заведомо устарел
+	if (modificationTime != QFileInfo(fileName).lastModified().toTime_t())
+		return QByteArray();
+
+	// проверяем размер бинарного представления, чтобы не принять обрезанный кэш, и хеш файла сцены
+	QByteArray hash;
+	stream >> hash >> dataSize;
+	if (stream.status() != QDataStream::Ok || file.size() - file.pos() != dataSize || hash != getFileHash(fileName))
+		return QByteArray();
+
+	// читаем бинарное представление сцены, следующее за заголовком, сразу в возвращаемый буфер
+	QByteArray data = file.read(dataSize);
+	return data.size() == static_cast<int>(dataSize) ? data : QByteArray();
+}
 
-	// записываем шапку файла
-	Utils::writeFileHeader(stream);
+bool Scene::saveCache(const QString &fileName)
+{
+	// разбираем только что записанный Lua скрипт, а не сохраняем текущую сцену, чтобы кэш содержал те же
+	// округленные при записи значения, что и файл, и загрузка из кэша не отличалась от загрузки скрипта
+	QByteArray data = parseScript(fileName);
+	if (data.isEmpty())
+		return false;
 
-	// записываем код для возврата корневой таблицы
-	stream << endl << "return" << endl;
-	stream << "{" << endl;
+	// записываем версию кэша, время изменения и хеш файла сцены и размер бинарного представления, а затем его само
+	QByteArray cache;
+	QDataStream stream(&cache, QIODevice::WriteOnly);
+	stream.setVersion(QDataStream::Qt_4_5);
+	stream << CACHE_MAGIC << CACHE_VERSION << QFileInfo(fileName).lastModified().toTime_t() << getFileHash(fileName) << static_cast<quint32>(data.size());
+	stream.writeRawData(data.constData(), data.size());
 
+	// заменяем файл кэша атомарно, чтобы сбой при записи не оставил кэш с верным заголовком и обрезанными данными
+	return Utils::writeFileAtomically(getCacheFileName(fileName), cache);
+}
+
+bool Scene::saveData(QDataStream &stream)
+{
 	// сохраняем слои
-	stream << "\t-- Layers table" << endl;
-	stream << "\tlayers =" << endl;
-	mRootLayer->save(stream, 1);
-	stream << "," << endl;
+	if (!mRootLayer->save(stream))
+		return false;
 
 	// сохраняем последовательность индексов, ведущую к активному слою
-	QStringList indices;
+	QList<int> indices;
 	for (BaseLayer *layer = mActiveLayer; layer != mRootLayer; layer = layer->getParentLayer())
-		indices.push_front(QString::number(layer->getParentLayer()->indexOfChildLayer(layer)));
-	stream << endl << "\t-- Path to the current active layer" << endl;
-	stream << "\tactiveLayer = {" << indices.join(", ") << "}," << endl;
+		indices.push_front(layer->getParentLayer()->indexOfChildLayer(layer));
+	stream << indices;
 
-	// сохраняем счетчики для генерации имен
-	stream << endl << "\t-- Counters for generating various object IDs" << endl;
-	stream << "\tobjectIndex = " << mObjectIndex << "," << endl;
-	stream << "\tlayerIndex = " << mLayerIndex << "," << endl;
-	stream << "\tlayerGroupIndex = " << mLayerGroupIndex << "," << endl;
-	stream << "\tspriteIndex = " << mSpriteIndex << "," << endl;
-	stream << "\tlabelIndex = " << mLabelIndex << "," << endl;
+	// сохраняем счетчики для генерации имен и направляющие
+	stream << mObjectIndex << mLayerIndex << mLayerGroupIndex << mSpriteIndex << mLabelIndex << mHorzGuides << mVertGuides;
+	return stream.status() == QDataStream::Ok;
+}
 
-	// сохраняем горизонтальные направляющие
-	QStringList horzGuides;
-	foreach (qreal coord, mHorzGuides)
-		horzGuides.push_back(QString::number(coord));
-	stream << endl << "\t-- Coordinates of horizontal and vertical guides" << endl;
-	stream << "\thorzGuides = {" << horzGuides.join(", ") << "}," << endl;
+bool Scene::loadTranslationFile(const QString &fileName)
+{
+	// загружаем Lua скрипт и проверяем, что он вернул корневую таблицу
+	LuaScript script;
+	if (!script.load(fileName, 1) || !script.pushTable())
+	{
+		mRootLayer->loadTranslations(NULL);
+		return false;
+	}
 
-	// сохраняем вертикальные направляющие
-	QStringList vertGuides;
-	foreach (qreal coord, mVertGuides)
-		vertGuides.push_back(QString::number(coord));
-	stream << "\tvertGuides = {" << vertGuides.join(", ") << "}" << endl;
+	// загружаем переводы из Lua скрипта
+	mRootLayer->loadTranslations(&script);
 
-	// записываем закрывающую фигурную скобку корневой таблицы
-	stream << "}" << endl;
+	// извлекаем из стека корневую таблицу
+	script.popTable();
 
-	return stream.status() == QTextStream::Ok;
+	return true;
 }
 
-bool Scene::loadTranslationFile(const QString &fileName)
+bool Scene::loadTranslationFile(const QString &fileName, const QList<GameObject *> &objects)
 {
+	// выбираем надписи, так как переводы есть только у них
+	QList<GameObject *> labels;
+	foreach (GameObject *object, objects)
+		if (dynamic_cast<Label *>(object) != NULL)
+			labels.push_back(object);
+
+	// не загружаем файл переводов, если надписей нет
+	if (labels.empty())
+		return true;
+
 	// загружаем Lua скрипт и проверяем, что он вернул корневую таблицу
 	LuaScript script;
 	if (!script.load(fileName, 1) || !script.pushTable())
 	{
-		mRootLayer->loadTranslations(NULL);
+		foreach (GameObject *object, labels)
+			object->loadTranslations(NULL);
 		return false;
 	}
 
 	// загружаем переводы из Lua скрипта
-	mRootLayer->loadTranslations(&script);
+	foreach (GameObject *object, labels)
+		object->loadTranslations(&script);
 
 	// извлекаем из стека корневую таблицу
 	script.popTable();
@@ -244,8 +489,15 @@ void Scene::setClean()
 
 void Scene::pushCommand(const QString &commandName)
 {
+	// вычитаем из занимаемой памяти отмененные команды, удаляемые стеком при добавлении новой команды
+	for (int i = mUndoStack->index() + 1; i <= mUndoStack->count(); ++i)
+		mUndoMemoryUsage -= getUndoCommand(i)->getMemoryUsage();
+
 	mCommandIndex = mUndoStack->index() + 1;
-	mUndoStack->push(new UndoCommand(commandName, this));
+	UndoCommand *command = new UndoCommand(commandName, this);
+	mUndoMemoryUsage += command->getMemoryUsage();
+	mUndoStack->push(command);
+	trimUndoStack();
 }
 
 bool Scene::canUndo() const
@@ -268,6 +520,27 @@ void Scene::redo()
 	mUndoStack->redo();
 }
 
+qint64 Scene::getUndoMemoryUsage() const
+{
+	// записи соседних команд разделяют общие данные, поэтому каждая команда учитывает только свои новые записи
+	return mUndoMemoryUsage;
+}
+
+QList<GameObject *> Scene::getRestoredGameObjects() const
+{
+	return mRestoredObjects;
+}
+
+QList<BaseLayer *> Scene::getRestoredLayers() const
+{
+	return mRestoredLayers.toList();
+}
+
+bool Scene::isLayerTreeRestored() const
+{
+	return mLayerTreeRestored;
+}
+
 BaseLayer *Scene::createLayer(BaseLayer *parent, int index)
 {
 	return new Layer(QString("Слой %1").arg(mLayerIndex++), parent, index);
@@ -312,31 +585,24 @@ GameObject *Scene::loadGameObject(QDataStream &stream)
 		return NULL;
 	}
 
+	// загружаем ресурсы объекта
+	if (mLoadResources)
+		object->loadResources();
 	return object;
 }
 
 QString Scene::generateDuplicateName(const QString &name) const
 {
-	// выделяем базовую часть имени
-	QString baseName = name;
-	int index = 0;
-	QRegExp regexp;
-	if ((regexp = QRegExp("(.*) копия (\\d+)")).exactMatch(name) && regexp.capturedTexts()[2].toInt() >= 2)
-	{
-		baseName = regexp.capturedTexts()[1];
-		index = regexp.capturedTexts()[2].toInt();
-	}
-	else if ((regexp = QRegExp("(.*) копия")).exactMatch(name))
-	{
-		baseName = regexp.capturedTexts()[1];
-		index = 1;
-	}
-
-	// подбираем индекс для нового имени
-	QString newName = name;
-	for (int i = index; mRootLayer->findGameObjectByName(newName) != NULL; ++i)
-		newName = baseName + " копия" + (i > 1 ? " " + QString::number(i) : "");
-	return newName;
+	// свободное имя оставляем без изменений
+	if (mRootLayer->findGameObjectByName(name) == NULL)
+		return name;
+
+	// выделяем базовую часть имени и берем наименьший свободный номер копии, начиная с номера исходного имени,
+	// как при переборе имен по порядку; диапазоны занятых номеров в индексе имен дерева дают его без перебора
+	QString baseName;
+	int index;
+	NameIndex::splitName(name, baseName, index);
+	return NameIndex::joinName(baseName, mRootLayer->findFreeCopyIndex(baseName, qMax(index, 1)));
 }
 
 int Scene::generateDuplicateObjectID()
@@ -395,62 +661,572 @@ void Scene::removeGuide(bool horz, int index)
 void Scene::onUndoStackIndexChanged(int index)
 {
 	// восстанавливаем ранее сохраненное состояние сцены и посылаем сигнал об изменении текущей команды в стеке отмен
-	if (mCommandIndex != index)
+	if (mCommandIndex != index && !mTrimmingUndoStack)
 	{
+		QSet<quint32> changedKeys;
+		moveUndoRecords(index, changedKeys);
 		mCommandIndex = index;
-		QUndoCommand *command = mCommandIndex > 0 ? const_cast<QUndoCommand *>(mUndoStack->command(mCommandIndex - 1)) : mInitialState;
-		dynamic_cast<UndoCommand *>(command)->restore();
+		patchUndoRecords(changedKeys);
 		emit undoCommandChanged();
 	}
 }
 
-bool Scene::load(QDataStream &stream)
+const Scene::UndoCommand *Scene::getUndoCommand(int index) const
 {
-	// сохраняем текущий корневой слой для отложенного удаления при выходе из функции, чтобы минимизировать загрузку/выгрузку ресурсов
-	QScopedPointer<BaseLayer> oldRootLayer(mRootLayer);
+	return index > 0 ? static_cast<const UndoCommand *>(mUndoStack->command(index - 1)) : mInitialState;
+}
 
-	// пересоздаем корневой слой
-	mRootLayer = new LayerGroup();
+void Scene::recordUndoChanges(UndoRecordMap &oldRecords, UndoRecordMap &newRecords, QByteArray &oldHeader, QByteArray &newHeader)
+{
+	// записываем изменившиеся слои и объекты, собирая ключи отсоединенных и присоединенных элементов
+	QList<quint32> removedKeys;
+	QSet<quint32> attachedKeys;
+	recordLayerChanges(mRootLayer, oldRecords, newRecords, removedKeys, attachedKeys);
 
-	// загружаем слои
-	QString type;
-	stream >> type;
-	if (stream.status() != QDataStream::Ok || type != "LayerGroup" || !mRootLayer->load(stream) || mRootLayer->getNumChildLayers() == 0)
+	// удаляем записи элементов, которые не были присоединены к другим слоям, вместе со всеми их дочерними элементами
+	while (!removedKeys.empty())
+	{
+		quint32 key = removedKeys.takeLast();
+		UndoRecordMap::iterator it = mUndoRecords.find(key);
+		if (it == mUndoRecords.end() || attachedKeys.contains(key))
+			continue;
+
+		removedKeys.append(it->mChildren);
+		oldRecords.insert(key, *it);
+		newRecords.insert(key, UndoRecord());
+		mUndoRecords.erase(it);
+	}
+
+	// записываем общие свойства сцены
+	oldHeader = mUndoHeader;
+	newHeader = mUndoHeader = saveHeader();
+}
+
+void Scene::recordLayerChanges(BaseLayer *layer, UndoRecordMap &oldRecords, UndoRecordMap &newRecords, QList<quint32> &removedKeys, QSet<quint32> &attachedKeys)
+{
+	// назначаем ключ новому слою
+	if (layer->getUndoKey() == 0)
+		layer->setUndoKey(mUndoKeyIndex++);
+
+	// записываем дочерние слои или игровые объекты
+	QList<quint32> children;
+	Layer *objectLayer = dynamic_cast<Layer *>(layer);
+	if (objectLayer != NULL)
+	{
+		foreach (GameObject *object, objectLayer->getGameObjects())
+		{
+			// назначаем ключ новому объекту
+			if (object->getUndoKey() == 0)
+				object->setUndoKey(mUndoKeyIndex++);
+
+			// сериализуем только измененные объекты
+			if (object->isUndoDirty())
+			{
+				QByteArray data;
+				QDataStream stream(&data, QIODevice::WriteOnly);
+				object->save(stream);
+				replaceUndoRecord(object->getUndoKey(), packUndoRecord(data), oldRecords, newRecords);
+				object->setUndoDirty(false);
+			}
+
+			children.push_back(object->getUndoKey());
+		}
+	}
+	else
+	{
+		foreach (BaseLayer *childLayer, layer->getChildLayers())
+		{
+			recordLayerChanges(childLayer, oldRecords, newRecords, removedKeys, attachedKeys);
+			children.push_back(childLayer->getUndoKey());
+		}
+	}
+
+	// записываем свойства и список дочерних элементов измененного слоя
+	if (layer->isUndoDirty())
+	{
+		QByteArray data;
+		QDataStream stream(&data, QIODevice::WriteOnly);
+		stream << QString(objectLayer != NULL ? "Layer" : "LayerGroup");
+		layer->BaseLayer::save(stream);
+
+		// запоминаем отсоединенные и присоединенные дочерние элементы
+		QSet<quint32> childSet = children.toSet();
+		UndoRecordMap::const_iterator it = mUndoRecords.find(layer->getUndoKey());
+		if (it != mUndoRecords.end())
+		{
+			foreach (quint32 key, it->mChildren)
+				if (!childSet.contains(key))
+					removedKeys.push_back(key);
+		}
+		attachedKeys.unite(childSet);
+
+		replaceUndoRecord(layer->getUndoKey(), packUndoRecord(data, children), oldRecords, newRecords);
+		layer->setUndoDirty(false);
+	}
+}
+
+void Scene::replaceUndoRecord(quint32 key, const UndoRecord &record, UndoRecordMap &oldRecords, UndoRecordMap &newRecords)
+{
+	// пропускаем записи, не изменившиеся по содержимому
+	UndoRecordMap::iterator it = mUndoRecords.find(key);
+	if (it != mUndoRecords.end() && isUndoRecordEqual(*it, record))
+		return;
+
+	// запоминаем исходную и новую запись и заменяем запись состояния
+	oldRecords.insert(key, it != mUndoRecords.end() ? *it : UndoRecord());
+	newRecords.insert(key, record);
+	mUndoRecords.insert(key, record);
+}
+
+void Scene::moveUndoRecords(int index, QSet<quint32> &changedKeys)
+{
+	// выбираем ближайшее к нужному индексу исходное состояние: текущее или одну из контрольных точек
+	int startIndex = mCommandIndex;
+	for (int i = 0; i <= mUndoStack->count(); ++i)
+		if (qAbs(index - i) < qAbs(index - startIndex) && getUndoCommand(i)->isCheckpoint())
+			startIndex = i;
+
+	if (startIndex != mCommandIndex)
+		getUndoCommand(startIndex)->restoreCheckpoint(mUndoRecords, mUndoHeader, changedKeys);
+
+	// применяем или откатываем изменения команд между исходным и нужным индексами
+	for (int i = startIndex; i < index; ++i)
+		getUndoCommand(i + 1)->apply(mUndoRecords, mUndoHeader, changedKeys);
+	for (int i = startIndex; i > index; --i)
+		getUndoCommand(i)->revert(mUndoRecords, mUndoHeader, changedKeys);
+}
+
+void Scene::trimUndoStack()
+{
+	// выходим, если память для истории отмен не ограничена или ограничение не превышено
+	qint64 limit = qint64(Options::getSingleton().getUndoMemoryLimit()) * 1024 * 1024;
+	if (limit == 0 || mUndoMemoryUsage <= limit || mCommandIndex != mUndoStack->count())
+		return;
+
+	// удаляем старейшие команды с запасом, чтобы не пересоздавать стек отмен при каждой следующей команде,
+	// оставляя в стеке хотя бы одну команду
+	qint64 targetUsage = limit * UNDO_TRIM_PERCENT / 100;
+	qint64 usage = mUndoMemoryUsage;
+	int numDroppedCommands = 0;
+	while (usage > targetUsage && numDroppedCommands < mCommandIndex - 1)
+		usage -= getUndoCommand(++numDroppedCommands)->getMemoryUsage();
+	if (numDroppedCommands == 0)
+		return;
+
+	// вычисляем состояние сцены на момент последней удаляемой команды
+	UndoRecordMap records = mUndoRecords;
+	QByteArray header = mUndoHeader;
+	QSet<quint32> changedKeys;
+	for (int i = mCommandIndex; i > numDroppedCommands; --i)
+		getUndoCommand(i)->revert(records, header, changedKeys);
+
+	// копируем оставшиеся команды, так как стек отмен не позволяет удалять команды из начала;
+	// копирование дешево, так как записи команд разделяются неявно
+	QList<UndoCommand *> commands;
+	for (int i = numDroppedCommands + 1; i <= mCommandIndex; ++i)
+		commands.push_back(new UndoCommand(*getUndoCommand(i)));
+
+	// заменяем начальное состояние сцены контрольной точкой с вычисленным состоянием
+	usage -= mInitialState->getMemoryUsage();
+	delete mInitialState;
+	mInitialState = new UndoCommand(records, header);
+	mUndoMemoryUsage = usage + mInitialState->getMemoryUsage();
+
+	// пересоздаем стек отмен, сохраняя положение неизмененного состояния
+	int cleanIndex = mUndoStack->cleanIndex() - numDroppedCommands;
+	mTrimmingUndoStack = true;
+	mUndoStack->clear();
+	if (cleanIndex < 0)
+	{
+		// неизмененное состояние удалено: делаем его недостижимым, добавляя и удаляя вспомогательную команду
+		mUndoStack->push(new QUndoCommand());
+		mUndoStack->setClean();
+		mUndoStack->undo();
+	}
+	foreach (UndoCommand *command, commands)
+	{
+		if (mUndoStack->index() == cleanIndex)
+			mUndoStack->setClean();
+		mUndoStack->push(command);
+	}
+	if (mUndoStack->index() == cleanIndex)
+		mUndoStack->setClean();
+	mCommandIndex = mUndoStack->index();
+	mTrimmingUndoStack = false;
+}
+
+bool Scene::patchUndoRecords(QSet<quint32> changedKeys)
+{
+	// читаем ключи корневого и активного слоев
+	QDataStream stream(mUndoHeader);
+	quint32 rootKey, activeKey;
+	stream >> rootKey >> activeKey;
+	if (stream.status() != QDataStream::Ok)
 		return false;
 
+	// восстанавливаем сцену целиком, если корневой слой не совпадает
+	if (rootKey != mRootLayer->getUndoKey())
+		return restoreUndoRecords();
+
+	// собираем текущие слои и объекты по ключам
+	QHash<quint32, BaseLayer *> layers;
+	QHash<quint32, GameObject *> objects;
+	collectUndoElements(mRootLayer, layers, objects, changedKeys);
+
+	mRestoredObjects.clear();
+	mRestoredLayers.clear();
+	mLayerTreeRestored = false;
+
+	// перезагружаем на месте измененные объекты и свойства измененных слоев
+	QList<BaseLayer *> changedLayers;
+	foreach (quint32 key, changedKeys)
+	{
+		// удаленные элементы будут отсоединены от своих родительских слоев, новые - созданы при их присоединении
+		UndoRecordMap::const_iterator it = mUndoRecords.find(key);
+		if (it == mUndoRecords.end())
+			continue;
+
+		QByteArray recordData = unpackUndoRecord(*it);
+		QDataStream recordStream(recordData);
+		QString type;
+		recordStream >> type;
+
+		if (GameObject *object = objects.value(key))
+		{
+			object->load(recordStream);
+			if (mLoadResources)
+				object->loadResources();
+			object->setUndoDirty(false);
+			mRestoredObjects.push_back(object);
+			mRestoredLayers.insert(object->getParentLayer());
+		}
+		else if (BaseLayer *layer = layers.value(key))
+		{
+			// обновляем свойства слоя, только если они изменились
+			QByteArray data;
+			QDataStream dataStream(&data, QIODevice::WriteOnly);
+			dataStream << type;
+			layer->BaseLayer::save(dataStream);
+			if (data != recordData)
+			{
+				layer->BaseLayer::load(recordStream);
+				mLayerTreeRestored = true;
+			}
+			changedLayers.push_back(layer);
+		}
+	}
+
+	// приводим списки дочерних элементов измененных и созданных слоев в соответствие с записями
+	QList<BaseLayer *> detachedLayers;
+	QList<GameObject *> detachedObjects;
+	for (int i = 0; i < changedLayers.size(); ++i)
+		patchLayerChildren(changedLayers[i], layers, objects, changedLayers, detachedLayers, detachedObjects);
+
 	// устанавливаем активный слой
-	QList<int> indices;
-	stream >> indices;
-	if (stream.status() != QDataStream::Ok || indices.empty())
+	BaseLayer *activeLayer = layers.value(activeKey, mRootLayer);
+	if (activeLayer != mActiveLayer)
+	{
+		mActiveLayer = activeLayer;
+		mLayerTreeRestored = true;
+	}
+
+	// загружаем счетчики для генерации имен
+	stream >> mObjectIndex >> mLayerIndex >> mLayerGroupIndex >> mSpriteIndex >> mLabelIndex;
+
+	// загружаем направляющие
+	stream >> mHorzGuides >> mVertGuides;
+
+	// исключаем из списков восстановленных элементов отсоединенные слои и объекты
+	for (QSet<BaseLayer *>::iterator it = mRestoredLayers.begin(); it != mRestoredLayers.end(); )
+	{
+		if (*it == NULL || !isLayerAttached(*it))
+			it = mRestoredLayers.erase(it);
+		else
+			++it;
+	}
+	for (int i = mRestoredObjects.size() - 1; i >= 0; --i)
+		if (!mRestoredLayers.contains(mRestoredObjects[i]->getParentLayer()))
+			mRestoredObjects.removeAt(i);
+
+	// удаляем отсоединенные слои и объекты, не присоединенные к другим слоям
+	foreach (GameObject *object, detachedObjects)
+		if (object->getParentLayer() == NULL)
+			delete object;
+	foreach (BaseLayer *layer, detachedLayers)
+		if (layer->getParentLayer() == NULL)
+			delete layer;
+
+	return stream.status() == QDataStream::Ok;
+}
+
+void Scene::collectUndoElements(BaseLayer *layer, QHash<quint32, BaseLayer *> &layers, QHash<quint32, GameObject *> &objects, QSet<quint32> &changedKeys)
+{
+	// перезагружаем элементы с незаписанными изменениями
+	layers.insert(layer->getUndoKey(), layer);
+	if (layer->isUndoDirty())
+		changedKeys.insert(layer->getUndoKey());
+
+	Layer *objectLayer = dynamic_cast<Layer *>(layer);
+	if (objectLayer != NULL)
+	{
+		foreach (GameObject *object, objectLayer->getGameObjects())
+		{
+			objects.insert(object->getUndoKey(), object);
+			if (object->isUndoDirty())
+				changedKeys.insert(object->getUndoKey());
+		}
+	}
+	else
+	{
+		foreach (BaseLayer *childLayer, layer->getChildLayers())
+			collectUndoElements(childLayer, layers, objects, changedKeys);
+	}
+}
+
+BaseLayer *Scene::findOrCreateLayer(quint32 key, QHash<quint32, BaseLayer *> &layers, QList<BaseLayer *> &createdLayers)
+{
+	// возвращаем существующий слой
+	BaseLayer *layer = layers.value(key);
+	if (layer != NULL)
+		return layer;
+
+	// создаем слой нужного типа и загружаем его свойства
+	QDataStream stream(unpackUndoRecord(mUndoRecords[key]));
+	QString type;
+	stream >> type;
+	if (type == "Layer")
+		layer = new Layer();
+	else
+		layer = new LayerGroup();
+	layer->BaseLayer::load(stream);
+	layer->setUndoKey(key);
+
+	// добавляем слой в список для заполнения дочерними элементами
+	layers.insert(key, layer);
+	createdLayers.push_back(layer);
+	mLayerTreeRestored = true;
+	return layer;
+}
+
+GameObject *Scene::findOrCreateGameObject(quint32 key, QHash<quint32, GameObject *> &objects)
+{
+	// возвращаем существующий объект
+	GameObject *object = objects.value(key);
+	if (object != NULL)
+		return object;
+
+	// создаем объект по записи состояния
+	QDataStream stream(unpackUndoRecord(mUndoRecords[key]));
+	object = loadGameObject(stream);
+	if (object != NULL)
+	{
+		object->setUndoKey(key);
+		object->setUndoDirty(false);
+		objects.insert(key, object);
+		mRestoredObjects.push_back(object);
+	}
+	return object;
+}
+
+void Scene::patchLayerChildren(BaseLayer *layer, QHash<quint32, BaseLayer *> &layers, QHash<quint32, GameObject *> &objects,
+	QList<BaseLayer *> &createdLayers, QList<BaseLayer *> &detachedLayers, QList<GameObject *> &detachedObjects)
+{
+	const QList<quint32> &keys = mUndoRecords[layer->getUndoKey()].mChildren;
+	Layer *objectLayer = dynamic_cast<Layer *>(layer);
+	if (objectLayer != NULL)
+	{
+		// получаем нужный список объектов
+		QList<GameObject *> newObjects;
+		foreach (quint32 key, keys)
+			if (GameObject *object = findOrCreateGameObject(key, objects))
+				newObjects.push_back(object);
+
+		// отсоединяем объекты, отсутствующие в нужном списке
+		QSet<GameObject *> newObjectSet = newObjects.toSet();
+		QList<GameObject *> currentObjects = objectLayer->getGameObjects();
+		for (int i = currentObjects.size() - 1; i >= 0; --i)
+			if (!newObjectSet.contains(currentObjects[i]))
+			{
+				detachedObjects.push_back(currentObjects.takeAt(i));
+				objectLayer->removeGameObject(i);
+			}
+
+		// расставляем объекты в нужном порядке, перенося их из других слоев при необходимости
+		for (int i = 0; i < newObjects.size(); ++i)
+		{
+			GameObject *object = newObjects[i];
+			if (i < currentObjects.size() && currentObjects[i] == object)
+				continue;
+
+			Layer *parentLayer = object->getParentLayer();
+			if (parentLayer == objectLayer)
+			{
+				int index = currentObjects.indexOf(object, i);
+				currentObjects.removeAt(index);
+				objectLayer->removeGameObject(index);
+			}
+			else if (parentLayer != NULL)
+			{
+				parentLayer->removeGameObject(parentLayer->indexOfGameObject(object));
+			}
+
+			currentObjects.insert(i, object);
+			objectLayer->insertGameObject(i, object);
+		}
+
+		mRestoredLayers.insert(objectLayer);
+	}
+	else
+	{
+		// получаем нужный список дочерних слоев
+		QList<BaseLayer *> newLayers;
+		foreach (quint32 key, keys)
+			newLayers.push_back(findOrCreateLayer(key, layers, createdLayers));
+
+		// отсоединяем слои, отсутствующие в нужном списке
+		QSet<BaseLayer *> newLayerSet = newLayers.toSet();
+		QList<BaseLayer *> currentLayers = layer->getChildLayers();
+		for (int i = currentLayers.size() - 1; i >= 0; --i)
+			if (!newLayerSet.contains(currentLayers[i]))
+			{
+				detachedLayers.push_back(currentLayers.takeAt(i));
+				layer->removeChildLayer(i);
+				mLayerTreeRestored = true;
+			}
+
+		// расставляем слои в нужном порядке, перенося их из других групп при необходимости
+		for (int i = 0; i < newLayers.size(); ++i)
+		{
+			BaseLayer *childLayer = newLayers[i];
+			if (i < currentLayers.size() && currentLayers[i] == childLayer)
+				continue;
+
+			BaseLayer *parentLayer = childLayer->getParentLayer();
+			if (parentLayer == layer)
+			{
+				int index = currentLayers.indexOf(childLayer, i);
+				currentLayers.removeAt(index);
+				layer->removeChildLayer(index);
+			}
+			else if (parentLayer != NULL)
+			{
+				parentLayer->removeChildLayer(parentLayer->indexOfChildLayer(childLayer));
+			}
+
+			currentLayers.insert(i, childLayer);
+			layer->insertChildLayer(i, childLayer);
+			mLayerTreeRestored = true;
+		}
+	}
+
+	layer->setUndoDirty(false);
+}
+
+bool Scene::isLayerAttached(BaseLayer *layer) const
+{
+	while (layer->getParentLayer() != NULL)
+		layer = layer->getParentLayer();
+	return layer == mRootLayer;
+}
+
+bool Scene::restoreUndoRecords()
+{
+	// читаем ключи корневого и активного слоев
+	QDataStream stream(mUndoHeader);
+	quint32 rootKey, activeKey;
+	stream >> rootKey >> activeKey;
+	if (stream.status() != QDataStream::Ok)
 		return false;
 
-	mActiveLayer = mRootLayer;
-	foreach (int index, indices)
+	// сохраняем текущий корневой слой для отложенного удаления при выходе из функции, чтобы минимизировать загрузку/выгрузку ресурсов
+	QScopedPointer<BaseLayer> oldRootLayer(mRootLayer);
+
+	// пересоздаем слои и объекты по записям состояния
+	QHash<quint32, BaseLayer *> layers;
+	mRootLayer = restoreLayer(rootKey, layers);
+	if (mRootLayer == NULL)
 	{
-		if (index < 0 || index >= mActiveLayer->getNumChildLayers())
-			return false;
-		mActiveLayer = mActiveLayer->getChildLayer(index);
+		mRootLayer = oldRootLayer.take();
+		return false;
 	}
 
+	// устанавливаем активный слой
+	mActiveLayer = layers.value(activeKey, mRootLayer);
+
 	// загружаем счетчики для генерации имен
 	stream >> mObjectIndex >> mLayerIndex >> mLayerGroupIndex >> mSpriteIndex >> mLabelIndex;
 
 	// загружаем направляющие
 	stream >> mHorzGuides >> mVertGuides;
 
+	// считаем восстановленными все слои и объекты
+	mRestoredObjects = mRootLayer->getGameObjects();
+	mRestoredLayers.clear();
+	foreach (BaseLayer *layer, layers)
+		if (dynamic_cast<Layer *>(layer) != NULL)
+			mRestoredLayers.insert(layer);
+	mLayerTreeRestored = true;
+
 	return stream.status() == QDataStream::Ok;
 }
 
-bool Scene::save(QDataStream &stream)
+BaseLayer *Scene::restoreLayer(quint32 key, QHash<quint32, BaseLayer *> &layers)
 {
-	// сохраняем слои
-	mRootLayer->save(stream);
+	// читаем тип слоя
+	const UndoRecord &record = mUndoRecords[key];
+	QDataStream stream(unpackUndoRecord(record));
+	QString type;
+	stream >> type;
+	if (stream.status() != QDataStream::Ok)
+		return NULL;
 
-	// сохраняем последовательность индексов, ведущую к активному слою
-	QList<int> indices;
-	for (BaseLayer *layer = mActiveLayer; layer != mRootLayer; layer = layer->getParentLayer())
-		indices.push_front(layer->getParentLayer()->indexOfChildLayer(layer));
-	stream << indices;
+	// создаем слой нужного типа и загружаем его свойства
+	QScopedPointer<BaseLayer> layer;
+	if (type == "Layer")
+		layer.reset(new Layer());
+	else if (type == "LayerGroup")
+		layer.reset(new LayerGroup());
+	if (layer.isNull() || !layer->BaseLayer::load(stream))
+		return NULL;
+
+	// создаем дочерние игровые объекты или слои
+	Layer *objectLayer = dynamic_cast<Layer *>(layer.data());
+	foreach (quint32 childKey, record.mChildren)
+	{
+		if (objectLayer != NULL)
+		{
+			QDataStream objectStream(unpackUndoRecord(mUndoRecords[childKey]));
+			GameObject *object = loadGameObject(objectStream);
+			if (object == NULL)
+				return NULL;
+
+			object->setUndoKey(childKey);
+			object->setUndoDirty(false);
+			objectLayer->addGameObject(object);
+		}
+		else
+		{
+			BaseLayer *childLayer = restoreLayer(childKey, layers);
+			if (childLayer == NULL)
+				return NULL;
+
+			layer->addChildLayer(childLayer);
+		}
+	}
+
+	layer->setUndoKey(key);
+	layer->setUndoDirty(false);
+	layers.insert(key, layer.data());
+	return layer.take();
+}
+
+QByteArray Scene::saveHeader()
+{
+	QByteArray data;
+	QDataStream stream(&data, QIODevice::WriteOnly);
+
+	// сохраняем ключи корневого и активного слоев
+	stream << mRootLayer->getUndoKey() << mActiveLayer->getUndoKey();
 
 	// сохраняем счетчики для генерации имен
 	stream << mObjectIndex << mLayerIndex << mLayerGroupIndex << mSpriteIndex << mLabelIndex;
@@ -458,18 +1234,147 @@ bool Scene::save(QDataStream &stream)
 	// сохраняем направляющие
 	stream << mHorzGuides << mVertGuides;
 
-	return stream.status() == QDataStream::Ok;
+	return data;
+}
+
+Scene::UndoRecord Scene::packUndoRecord(const QByteArray &data, const QList<quint32> &children)
+{
+	// сжимаем большие записи, если это уменьшает их размер
+	UndoRecord record;
+	record.mData = data;
+	record.mChildren = children;
+	if (data.size() >= COMPRESSION_THRESHOLD)
+	{
+		QByteArray compressedData = qCompress(data);
+		if (compressedData.size() < data.size())
+		{
+			record.mData = compressedData;
+			record.mCompressed = true;
+		}
+	}
+	return record;
+}
+
+QByteArray Scene::unpackUndoRecord(const UndoRecord &record)
+{
+	return record.mCompressed ? qUncompress(record.mData) : record.mData;
+}
+
+bool Scene::isUndoRecordEqual(const UndoRecord &record1, const UndoRecord &record2)
+{
+	// сжатие детерминировано, поэтому одинаковые данные дают одинаковые сжатые данные
+	return record1.mCompressed == record2.mCompressed && record1.mData == record2.mData && record1.mChildren == record2.mChildren;
+}
+
+qint64 Scene::getUndoRecordsMemoryUsage(const UndoRecordMap &records, bool withData)
+{
+	qint64 usage = 0;
+	for (UndoRecordMap::const_iterator it = records.begin(); it != records.end(); ++it)
+	{
+		usage += RECORD_OVERHEAD + it->mChildren.size() * sizeof(quint32);
+		if (withData)
+			usage += it->mData.size();
+	}
+	return usage;
+}
+
+Scene::UndoRecord::UndoRecord()
+: mCompressed(false)
+{
 }
 
 Scene::UndoCommand::UndoCommand(const QString &text, Scene *scene)
-: QUndoCommand(text), mScene(scene)
+: QUndoCommand(text), mCheckpoint(false), mMemoryUsage(0)
 {
-	QDataStream stream(&mData, QIODevice::WriteOnly);
-	mScene->save(stream);
+	// записываем изменения с момента предыдущей команды
+	scene->recordUndoChanges(mOldRecords, mNewRecords, mOldHeader, mNewHeader);
+
+	// периодически сохраняем полное состояние сцены; для начального состояния изменения не нужны
+	if (scene->mCommandIndex % CHECKPOINT_INTERVAL == 0)
+	{
+		mCheckpoint = true;
+		mCheckpointRecords = scene->mUndoRecords;
+		if (scene->mCommandIndex == 0)
+		{
+			mOldRecords.clear();
+			mNewRecords.clear();
+			mOldHeader.clear();
+		}
+	}
+
+	updateMemoryUsage(scene->mCommandIndex == 0);
+}
+
+Scene::UndoCommand::UndoCommand(const UndoRecordMap &records, const QByteArray &header)
+: QUndoCommand(""), mNewHeader(header), mCheckpoint(true), mCheckpointRecords(records), mMemoryUsage(0)
+{
+	updateMemoryUsage(true);
+}
+
+Scene::UndoCommand::UndoCommand(const UndoCommand &command)
+: QUndoCommand(command.text()), mOldRecords(command.mOldRecords), mNewRecords(command.mNewRecords), mOldHeader(command.mOldHeader), mNewHeader(command.mNewHeader),
+  mCheckpoint(command.mCheckpoint), mCheckpointRecords(command.mCheckpointRecords), mMemoryUsage(command.mMemoryUsage)
+{
+}
+
+qint64 Scene::UndoCommand::getMemoryUsage() const
+{
+	return mMemoryUsage;
+}
+
+bool Scene::UndoCommand::isCheckpoint() const
+{
+	return mCheckpoint;
+}
+
+void Scene::UndoCommand::restoreCheckpoint(UndoRecordMap &records, QByteArray &header, QSet<quint32> &changedKeys) const
+{
+	// запоминаем ключи записей, отличающихся от контрольной точки
+	for (UndoRecordMap::const_iterator it = records.begin(); it != records.end(); ++it)
+	{
+		UndoRecordMap::const_iterator checkpointIt = mCheckpointRecords.find(it.key());
+		if (checkpointIt == mCheckpointRecords.end() || !isUndoRecordEqual(*checkpointIt, *it))
+			changedKeys.insert(it.key());
+	}
+	for (UndoRecordMap::const_iterator it = mCheckpointRecords.begin(); it != mCheckpointRecords.end(); ++it)
+		if (!records.contains(it.key()))
+			changedKeys.insert(it.key());
+
+	records = mCheckpointRecords;
+	header = mNewHeader;
+}
+
+void Scene::UndoCommand::revert(UndoRecordMap &records, QByteArray &header, QSet<quint32> &changedKeys) const
+{
+	applyRecords(mOldRecords, records, changedKeys);
+	header = mOldHeader;
+}
+
+void Scene::UndoCommand::apply(UndoRecordMap &records, QByteArray &header, QSet<quint32> &changedKeys) const
+{
+	applyRecords(mNewRecords, records, changedKeys);
+	header = mNewHeader;
+}
+
+void Scene::UndoCommand::applyRecords(const UndoRecordMap &changes, UndoRecordMap &records, QSet<quint32> &changedKeys)
+{
+	// заменяем измененные записи и удаляем отсутствующие
+	for (UndoRecordMap::const_iterator it = changes.begin(); it != changes.end(); ++it)
+	{
+		if (it->mData.isEmpty())
+			records.remove(it.key());
+		else
+			records.insert(it.key(), *it);
+		changedKeys.insert(it.key());
+	}
 }
 
-void Scene::UndoCommand::restore()
+void Scene::UndoCommand::updateMemoryUsage(bool initialState)
 {
-	QDataStream stream(&mData, QIODevice::ReadOnly);
-	mScene->load(stream);
+	// данные исходных записей разделяются с новыми записями предыдущих команд, а данные контрольной точки - с записями
+	// команд, поэтому полностью учитываются только новые записи и записи начального состояния
+	mMemoryUsage = mOldHeader.size() + mNewHeader.size();
+	mMemoryUsage += getUndoRecordsMemoryUsage(mOldRecords, false);
+	mMemoryUsage += getUndoRecordsMemoryUsage(mNewRecords, true);
+	mMemoryUsage += getUndoRecordsMemoryUsage(mCheckpointRecords, initialState);
 }
@@ -0,0 +1,115 @@
+#include "pch.h"
+#include "snap_index.h"
+#include "game_object.h"
+
+SnapIndex::SnapIndex()
+: mBuilt(false)
+{
+}
+
+bool SnapIndex::isBuilt() const
+{
+	return mBuilt;
+}
+
+void SnapIndex::build(const QList<GameObject *> &objects)
+{
+	clear();
+	mXEdges.reserve(objects.size() * 3);
+	mYEdges.reserve(objects.size() * 3);
+
+	// добавляем края и центры всех объектов
+	for (int i = 0; i < objects.size(); ++i)
+	{
+		GameObject *object = objects[i];
+		QRectF rect = object->getBoundingRect();
+		QPointF center = rect.center();
+
+		addEdge(mXEdges, center.x(), center.y(), center.y(), 0, i, object);
+		addEdge(mXEdges, rect.left(), rect.top(), rect.bottom(), 1, i, object);
+		addEdge(mXEdges, rect.right(), rect.top(), rect.bottom(), 2, i, object);
+
+		addEdge(mYEdges, center.y(), center.x(), center.x(), 0, i, object);
+		addEdge(mYEdges, rect.top(), rect.left(), rect.right(), 1, i, object);
+		addEdge(mYEdges, rect.bottom(), rect.left(), rect.right(), 2, i, object);
+	}
+
+	// сортируем края по координате для двоичного поиска
+	qSort(mXEdges.begin(), mXEdges.end(), edgeLessThan);
+	qSort(mYEdges.begin(), mYEdges.end(), edgeLessThan);
+	mBuilt = true;
+}
+
+void SnapIndex::clear()
+{
+	mXEdges.clear();
+	mYEdges.clear();
+	mBuilt = false;
+}
+
+void SnapIndex::snapXCoord(qreal x, qreal y1, qreal y2, const QSet<GameObject *> &excludedObjects, qreal &snappedX, qreal &distance, QLineF &line) const
+{
+	const Edge *edge = findNearestEdge(mXEdges, x, distance, excludedObjects);
+	if (edge != NULL)
+	{
+		distance = qAbs(x - edge->mCoord);
+		snappedX = edge->mCoord;
+		line = QLineF(snappedX, qMin(y1, edge->mMin), snappedX, qMax(y2, edge->mMax));
+	}
+}
+
+void SnapIndex::snapYCoord(qreal y, qreal x1, qreal x2, const QSet<GameObject *> &excludedObjects, qreal &snappedY, qreal &distance, QLineF &line) const
+{
+	const Edge *edge = findNearestEdge(mYEdges, y, distance, excludedObjects);
+	if (edge != NULL)
+	{
+		distance = qAbs(y - edge->mCoord);
+		snappedY = edge->mCoord;
+		line = QLineF(qMin(x1, edge->mMin), snappedY, qMax(x2, edge->mMax), snappedY);
+	}
+}
+
+bool SnapIndex::edgeLessThan(const Edge &edge1, const Edge &edge2)
+{
+	return edge1.mCoord < edge2.mCoord;
+}
+
+void SnapIndex::addEdge(QVector<Edge> &edges, qreal coord, qreal min, qreal max, int priority, int order, GameObject *object)
+{
+	Edge edge;
+	edge.mCoord = coord;
+	edge.mMin = min;
+	edge.mMax = max;
+	edge.mPriority = priority;
+	edge.mOrder = order;
+	edge.mObject = object;
+	edges.push_back(edge);
+}
+
+const SnapIndex::Edge *SnapIndex::findNearestEdge(const QVector<Edge> &edges, qreal coord, qreal distance, const QSet<GameObject *> &excludedObjects)
+{
+	// находим первый край, попадающий в окрестность координаты
+	Edge key;
+	key.mCoord = coord - distance;
+	QVector<Edge>::const_iterator it = qLowerBound(edges.constBegin(), edges.constEnd(), key, edgeLessThan);
+
+	// выбираем ближайший край в окрестности; при равном расстоянии, как и при обходе дерева слоев, побеждает
+	// объект, встретившийся раньше, а внутри объекта - центр, затем левый или верхний край, затем правый или нижний
+	const Edge *nearestEdge = NULL;
+	qreal nearestDistance = distance;
+	for (; it != edges.constEnd() && it->mCoord < coord + distance; ++it)
+	{
+		qreal edgeDistance = qAbs(coord - it->mCoord);
+		bool nearer = edgeDistance < nearestDistance;
+		if (!nearer && nearestEdge != NULL && edgeDistance == nearestDistance)
+			nearer = it->mOrder != nearestEdge->mOrder ? it->mOrder < nearestEdge->mOrder : it->mPriority < nearestEdge->mPriority;
+
+		if (nearer && !excludedObjects.contains(it->mObject))
+		{
+			nearestEdge = it;
+			nearestDistance = edgeDistance;
+		}
+	}
+
+	return nearestEdge;
+}
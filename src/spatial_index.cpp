@@ -0,0 +1,144 @@
+#include "pch.h"
+#include "spatial_index.h"
+#include "game_object.h"
+
+SpatialIndex::SpatialIndex()
+{
+}
+
+void SpatialIndex::insert(GameObject *object)
+{
+	// большие объекты храним отдельным списком, остальные раскладываем по ячейкам
+	QRect cellRect = getCellRect(object->getBoundingRect());
+	if (static_cast<qint64>(cellRect.width()) * cellRect.height() > MAX_OBJECT_CELLS)
+	{
+		mLargeObjects.insert(object);
+		mObjectCells.insert(object, QRect());
+	}
+	else
+	{
+		insertIntoCells(object, cellRect);
+		mObjectCells.insert(object, cellRect);
+	}
+}
+
+void SpatialIndex::remove(GameObject *object)
+{
+	// удаляем объект из ячеек или из списка больших объектов
+	QHash<GameObject *, QRect>::iterator it = mObjectCells.find(object);
+	if (it != mObjectCells.end())
+	{
+		if (it->isNull())
+			mLargeObjects.remove(object);
+		else
+			removeFromCells(object, *it);
+		mObjectCells.erase(it);
+	}
+}
+
+void SpatialIndex::update(GameObject *object)
+{
+	// перекладываем объект, только если изменился занимаемый им прямоугольник ячеек
+	QHash<GameObject *, QRect>::iterator it = mObjectCells.find(object);
+	if (it != mObjectCells.end())
+	{
+		QRect cellRect = getCellRect(object->getBoundingRect());
+		if (!it->isNull() && *it == cellRect)
+			return;
+
+		remove(object);
+		insert(object);
+	}
+}
+
+QList<GameObject *> SpatialIndex::findObjects(const QPointF &pt) const
+{
+	// проверяем объекты из ячейки, содержащей точку, и большие объекты
+	QList<GameObject *> objects;
+	QRect cellRect = getCellRect(QRectF(pt, pt));
+	QHash<quint64, QList<GameObject *> >::const_iterator it = mCells.find(getCellKey(cellRect.left(), cellRect.top()));
+	if (it != mCells.end())
+	{
+		foreach (GameObject *object, *it)
+			if (object->getBoundingRect().contains(pt))
+				objects.push_back(object);
+	}
+
+	foreach (GameObject *object, mLargeObjects)
+		if (object->getBoundingRect().contains(pt))
+			objects.push_back(object);
+
+	return objects;
+}
+
+QList<GameObject *> SpatialIndex::findObjects(const QRectF &rect) const
+{
+	// собираем объекты из всех ячеек, пересекающихся с прямоугольником, без повторов
+	QSet<GameObject *> candidates;
+	QRect cellRect = getCellRect(rect);
+	if (static_cast<qint64>(cellRect.width()) * cellRect.height() > mCells.size())
+	{
+		// прямоугольник покрывает больше ячеек, чем заполнено в сетке, поэтому проходим по непустым ячейкам
+		for (QHash<quint64, QList<GameObject *> >::const_iterator it = mCells.begin(); it != mCells.end(); ++it)
+			foreach (GameObject *object, *it)
+				candidates.insert(object);
+	}
+	else
+	{
+		for (int y = cellRect.top(); y <= cellRect.bottom(); ++y)
+			for (int x = cellRect.left(); x <= cellRect.right(); ++x)
+			{
+				QHash<quint64, QList<GameObject *> >::const_iterator it = mCells.find(getCellKey(x, y));
+				if (it != mCells.end())
+					foreach (GameObject *object, *it)
+						candidates.insert(object);
+			}
+	}
+	candidates |= mLargeObjects;
+
+	// оставляем только объекты, действительно пересекающиеся с прямоугольником (включая объекты нулевого размера)
+	QList<GameObject *> objects;
+	foreach (GameObject *object, candidates)
+	{
+		QRectF boundingRect = object->getBoundingRect();
+		if (boundingRect.left() <= rect.right() && boundingRect.right() >= rect.left()
+			&& boundingRect.top() <= rect.bottom() && boundingRect.bottom() >= rect.top())
+			objects.push_back(object);
+	}
+
+	return objects;
+}
+
+QRect SpatialIndex::getCellRect(const QRectF &rect)
+{
+	return QRect(QPoint(qFloor(rect.left() / CELL_SIZE), qFloor(rect.top() / CELL_SIZE)),
+		QPoint(qFloor(rect.right() / CELL_SIZE), qFloor(rect.bottom() / CELL_SIZE)));
+}
+
+quint64 SpatialIndex::getCellKey(int x, int y)
+{
+	return (static_cast<quint64>(static_cast<quint32>(x)) << 32) | static_cast<quint32>(y);
+}
+
+void SpatialIndex::insertIntoCells(GameObject *object, const QRect &cellRect)
+{
+	for (int y = cellRect.top(); y <= cellRect.bottom(); ++y)
+		for (int x = cellRect.left(); x <= cellRect.right(); ++x)
+			mCells[getCellKey(x, y)].push_back(object);
+}
+
+void SpatialIndex::removeFromCells(GameObject *object, const QRect &cellRect)
+{
+	for (int y = cellRect.top(); y <= cellRect.bottom(); ++y)
+		for (int x = cellRect.left(); x <= cellRect.right(); ++x)
+		{
+			// удаляем опустевшие ячейки, чтобы не накапливать их при перемещении объектов
+			QHash<quint64, QList<GameObject *> >::iterator it = mCells.find(getCellKey(x, y));
+			if (it != mCells.end())
+			{
+				it->removeOne(object);
+				if (it->empty())
+					mCells.erase(it);
+			}
+		}
+}
@@ -3,6 +3,7 @@
 #include "layer.h"
 #include "lua_script.h"
 #include "project.h"
+#include "sprite_batch.h"
 #include "texture_manager.h"
 #include "utils.h"
 
@@ -25,7 +26,7 @@ Sprite::Sprite(const QString &name, int id, const QPointF &pos, const QString &f
 	}
 
 	// инициализируем локализованные свойства
-	QString language = Project::getSingleton().getDefaultLanguage();
+	int language = Project::getSingleton().getDefaultLanguageId();
 	mPositionXMap[language] = mPosition.x();
 	mPositionYMap[language] = mPosition.y();
 	mWidthMap[language] = mSize.width();
@@ -42,8 +43,9 @@ Sprite::Sprite(const QString &name, int id, const QPointF &pos, const QString &f
 
 Sprite::~Sprite()
 {
-	// устанавливаем текущий контекст OpenGL для корректного удаления текстуры спрайта
-	TextureManager::getSingleton().makeCurrent();
+	// устанавливаем текущий контекст OpenGL для корректного удаления текстуры спрайта, если текстуры загружались
+	if (!mTextureMap.isEmpty())
+		TextureManager::getSingleton().makeCurrent();
 }
 
 QString Sprite::getFileName() const
@@ -59,9 +61,10 @@ void Sprite::setFileName(const QString &fileName)
 	mTexture = TextureManager::getSingleton().loadTexture(mFileName);
 
 	// записываем локализованное имя файла и текстуру для текущего языка
-	QString language = Project::getSingleton().getCurrentLanguage();
+	int language = Project::getSingleton().getCurrentLanguageId();
 	mFileNameMap[language] = mFileName;
 	mTextureMap[language] = mTexture;
+	mUndoDirty = true;
 
 	// пересчитываем размер спрайта, если загружена валидная текстура
 	if (!mTexture->isDefault())
@@ -75,7 +78,7 @@ void Sprite::setFileName(const QString &fileName)
 
 QSizeF Sprite::getTextureSize() const
 {
-	QString language = isLocalized() ? Project::getSingleton().getCurrentLanguage() : Project::getSingleton().getDefaultLanguage();
+	int language = isLocalized() ? Project::getSingleton().getCurrentLanguageId() : Project::getSingleton().getDefaultLanguageId();
 	return QSizeF(mTextureWidthMap[language], mTextureHeightMap[language]);
 }
 
@@ -97,6 +100,7 @@ QColor Sprite::getColor() const
 void Sprite::setColor(const QColor &color)
 {
 	mColor = color;
+	mUndoDirty = true;
 }
 
 bool Sprite::load(QDataStream &stream)
@@ -110,8 +114,6 @@ bool Sprite::load(QDataStream &stream)
 	if (stream.status() != QDataStream::Ok)
 		return false;
 
-	// загружаем локализованные текстуры
-	loadTextures();
 	return true;
 }
 
@@ -133,20 +135,42 @@ bool Sprite::save(QDataStream &stream)
 
 bool Sprite::load(LuaScript &script)
 {
-	// загружаем общие данные игрового объекта
-	if (!GameObject::load(script))
-		return false;
+	// загружаем общие данные игрового объекта и данные спрайта; текстуры не загружаются, так как разбор
+	// Lua скрипта выполняется в рабочем потоке, а текстуры загружаются сценой функцией loadResources
+	return loadProperties(script, NUM_PROPERTIES);
+}
 
-	// загружаем данные спрайта
+bool Sprite::loadProperty(LuaScript &script, int key, int &numProperties)
+{
 	unsigned int color;
-	if (!readStringMap(script, "fileName", mFileNameMap) || !readRealMap(script, "textureWidth", mTextureWidthMap)
-		|| !readRealMap(script, "textureHeight", mTextureHeightMap) || !script.getUnsignedInt("color", color))
-		return false;
-	mColor = QColor::fromRgba(color);
+	bool result;
+	switch (key)
+	{
+	case KEY_FILE_NAME:
+		result = readStringMap(script, mFileNameMap);
+		break;
+
+	case KEY_TEXTURE_WIDTH:
+		result = readRealMap(script, mTextureWidthMap);
+		break;
+
+	case KEY_TEXTURE_HEIGHT:
+		result = readRealMap(script, mTextureHeightMap);
+		break;
+
+	case KEY_COLOR:
+		result = script.getUnsignedInt(color);
+		if (result)
+			mColor = QColor::fromRgba(color);
+		break;
+
+	default:
+		// загружаем общие свойства игрового объекта
+		return GameObject::loadProperty(script, key, numProperties);
+	}
 
-	// загружаем локализованные текстуры
-	loadTextures();
-	return true;
+	++numProperties;
+	return result;
 }
 
 bool Sprite::save(QTextStream &stream, int indent)
@@ -169,28 +193,28 @@ bool Sprite::save(QTextStream &stream, int indent)
 	return stream.status() == QTextStream::Ok;
 }
 
-void Sprite::setCurrentLanguage(const QString &language)
+void Sprite::setCurrentLanguage(int language)
 {
 	// устанавливаем язык для игрового объекта
 	GameObject::setCurrentLanguage(language);
 
 	// устанавливаем новые значения для имени файла и текстуры
-	QString currentLanguage = isLocalized() ? language : Project::getSingleton().getDefaultLanguage();
+	int currentLanguage = isLocalized() ? language : Project::getSingleton().getDefaultLanguageId();
 	mFileName = mFileNameMap[currentLanguage];
 	mTexture = mTextureMap[currentLanguage];
 }
 
 bool Sprite::isLocalized() const
 {
-	QString language = Project::getSingleton().getCurrentLanguage();
+	int language = Project::getSingleton().getCurrentLanguageId();
 	return GameObject::isLocalized() && mFileNameMap.contains(language) && mTextureMap.contains(language)
 		&& mTextureWidthMap.contains(language) && mTextureHeightMap.contains(language);
 }
 
 void Sprite::setLocalized(bool localized)
 {
-	QString currentLanguage = Project::getSingleton().getCurrentLanguage();
-	QString defaultLanguage = Project::getSingleton().getDefaultLanguage();
+	int currentLanguage = Project::getSingleton().getCurrentLanguageId();
+	int defaultLanguage = Project::getSingleton().getDefaultLanguageId();
 	Q_ASSERT(currentLanguage != defaultLanguage);
 
 	// устанавливаем локализацию для игрового объекта
@@ -214,7 +238,7 @@ void Sprite::setLocalized(bool localized)
 	}
 
 	// устанавливаем текущий язык
-	setCurrentLanguage(Project::getSingleton().getCurrentLanguage());
+	setCurrentLanguage(Project::getSingleton().getCurrentLanguageId());
 }
 
 GameObject *Sprite::duplicate(Layer *parent) const
@@ -230,9 +254,9 @@ QStringList Sprite::getMissedFiles() const
 {
 	// возвращаем имена незагруженных текстур
 	QStringList missedFiles;
-	for (StringMap::const_iterator it = mFileNameMap.begin(); it != mFileNameMap.end(); ++it)
-		if (mTextureMap[it.key()]->isDefault())
-			missedFiles.push_back(*it);
+	for (int language = mFileNameMap.nextLanguage(); language != -1; language = mFileNameMap.nextLanguage(language))
+		if (mTextureMap[language]->isDefault())
+			missedFiles.push_back(mFileNameMap[language]);
 	return missedFiles;
 }
 
@@ -240,16 +264,25 @@ bool Sprite::changeTexture(const QString &fileName, const QSharedPointer<Texture
 {
 	// заменяем старую текстуру спрайта на новую
 	bool changed = false;
-	for (StringMap::const_iterator it = mFileNameMap.begin(); it != mFileNameMap.end(); ++it)
-		if (*it == fileName)
+	for (int language = mFileNameMap.nextLanguage(); language != -1; language = mFileNameMap.nextLanguage(language))
+		if (mFileNameMap[language] == fileName)
 		{
+			// заглушку асинхронной загрузки заменяем загруженной текстурой того же размера без изменения состояния объекта
+			if (mTextureMap[language]->isPlaceholder() && !texture->isDefault() && mTextureMap[language]->getSize() == texture->getSize())
+			{
+				mTextureMap[language] = texture;
+				if (language == Project::getSingleton().getCurrentLanguageId())
+					mTexture = texture;
+				continue;
+			}
+
 			// сохраняем новую текстуру
-			const QString &language = it.key();
 			mTextureMap[language] = texture;
+			mUndoDirty = true;
 			changed = true;
 
 			// заменяем текстуру для текущего языка
-			if (language == Project::getSingleton().getCurrentLanguage())
+			if (language == Project::getSingleton().getCurrentLanguageId())
 				mTexture = texture;
 
 			// пересчитываем размер спрайта, если загружена валидная текстура
@@ -263,7 +296,7 @@ bool Sprite::changeTexture(const QString &fileName, const QSharedPointer<Texture
 				mTextureHeightMap[language] = texture->getHeight();
 
 				// устанавливаем новый размер для текущего языка
-				if (language == Project::getSingleton().getCurrentLanguage())
+				if (language == Project::getSingleton().getCurrentLanguageId())
 					setSize(QSizeF(mWidthMap[language], mHeightMap[language]));
 			}
 		}
@@ -271,33 +304,20 @@ bool Sprite::changeTexture(const QString &fileName, const QSharedPointer<Texture
 	return changed;
 }
 
-void Sprite::draw()
+void Sprite::draw(SpriteBatch &batch)
 {
-	// сохраняем матрицу трансформации
-	glPushMatrix();
-
-	// задаем новую трансформацию и цвет
-	glTranslated(mPosition.x(), mPosition.y(), 0.0);
-	glRotated(mRotationAngle, 0.0, 0.0, 1.0);
-	glScaled(mSize.width() / mTexture->getWidth(), mSize.height() / mTexture->getHeight(), 1.0);
-	glColor4d(mColor.redF(), mColor.greenF(), mColor.blueF(), mColor.alphaF());
-
-	// рисуем квад с текстурой спрайта
-	mTexture->draw();
-
-	// восстанавливаем матрицу трансформации
-	glPopMatrix();
+	// добавляем в пакет квад спрайта, вершины которого уже рассчитаны в мировых координатах
+	batch.addQuad(mTexture.data(), mVertices, mColor);
 }
 
-void Sprite::loadTextures()
+void Sprite::loadResources()
 {
 	// загружаем локализованные текстуры
 	mTextureMap.clear();
-	for (StringMap::const_iterator it = mFileNameMap.begin(); it != mFileNameMap.end(); ++it)
+	for (int language = mFileNameMap.nextLanguage(); language != -1; language = mFileNameMap.nextLanguage(language))
 	{
-		// загружаем текстуру
-		const QString &language = it.key();
-		QSharedPointer<Texture> texture = TextureManager::getSingleton().loadTexture(*it);
+		// загружаем текстуру асинхронно: до завершения загрузки используется заглушка с размерами изображения
+		QSharedPointer<Texture> texture = TextureManager::getSingleton().loadTexture(mFileNameMap[language], true, true);
 		mTextureMap[language] = texture;
 
 		// пересчитываем размер спрайта, если загружена валидная текстура
@@ -313,5 +333,5 @@ void Sprite::loadTextures()
 	}
 
 	// устанавливаем текущий язык
-	setCurrentLanguage(Project::getSingleton().getCurrentLanguage());
+	setCurrentLanguage(Project::getSingleton().getCurrentLanguageId());
 }
@@ -0,0 +1,83 @@
+#include "pch.h"
+#include "sprite_batch.h"
+#include "texture.h"
+
+SpriteBatch::SpriteBatch()
+: mVertices(4096), mNumVertices(0), mTexture(0), mNumCulledObjects(0)
+{
+}
+
+void SpriteBatch::addQuad(const Texture *texture, const QPointF *vertices, const QColor &color)
+{
+	// при смене текстуры отрисовываем накопленный пакет, сохраняя порядок отрисовки
+	if (texture->getHandle() != mTexture)
+	{
+		flush();
+		mTexture = texture->getHandle();
+	}
+
+	// увеличиваем буфер вершин при необходимости
+	if (mNumVertices + 4 > mVertices.size())
+		mVertices.resize(mVertices.size() * 2);
+
+	// текстурные координаты вершин квада (верхняя строка изображения находится в начале текстуры)
+	static const GLfloat texCoords[4][2] = {{0.0f, 0.0f}, {0.0f, 1.0f}, {1.0f, 1.0f}, {1.0f, 0.0f}};
+
+	// записываем вершины квада в буфер
+	Vertex *vertex = mVertices.data() + mNumVertices;
+	for (int i = 0; i < 4; ++i, ++vertex)
+	{
+		vertex->mTexCoord[0] = texCoords[i][0];
+		vertex->mTexCoord[1] = texCoords[i][1];
+		vertex->mColor[0] = color.red();
+		vertex->mColor[1] = color.green();
+		vertex->mColor[2] = color.blue();
+		vertex->mColor[3] = color.alpha();
+		vertex->mPosition[0] = vertices[i].x();
+		vertex->mPosition[1] = vertices[i].y();
+	}
+	mNumVertices += 4;
+}
+
+void SpriteBatch::flush()
+{
+	// выходим, если пакет пуст
+	if (mNumVertices == 0)
+		return;
+
+	// задаем массивы вершин
+	const Vertex *vertices = mVertices.constData();
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(Vertex), vertices->mPosition);
+	glTexCoordPointer(2, GL_FLOAT, sizeof(Vertex), vertices->mTexCoord);
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), vertices->mColor);
+
+	// отрисовываем все квады пакета одним вызовом
+	glBindTexture(GL_TEXTURE_2D, mTexture);
+	glDrawArrays(GL_QUADS, 0, mNumVertices);
+
+	// отключаем массивы вершин
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+
+	// очищаем пакет
+	mNumVertices = 0;
+}
+
+void SpriteBatch::addCulledObjects(int count)
+{
+	mNumCulledObjects += count;
+}
+
+int SpriteBatch::getNumCulledObjects() const
+{
+	return mNumCulledObjects;
+}
+
+void SpriteBatch::resetNumCulledObjects(int count)
+{
+	mNumCulledObjects = count;
+}
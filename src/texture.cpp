@@ -1,5 +1,6 @@
 #include "pch.h"
 #include "texture.h"
+#include "pixel_converter.h"
 
 Texture::Texture()
 : mHandle(0), mDefault(true)
@@ -13,9 +14,21 @@ Texture::Texture(const QString &fileName)
 	load(fileName);
 }
 
+Texture::Texture(const QImage &image)
+: mHandle(0), mDefault(false)
+{
+	upload(image);
+}
+
+Texture::Texture(const QSize &size, const QSharedPointer<Texture> &defaultTexture)
+: mHandle(defaultTexture->getHandle()), mSize(size), mDefault(false), mDefaultTexture(defaultTexture)
+{
+}
+
 Texture::~Texture()
 {
-	if (mHandle != 0)
+	// удаляем текстуру, если она не принадлежит текстуре по умолчанию
+	if (mHandle != 0 && mDefaultTexture.isNull())
 		glDeleteTextures(1, &mHandle);
 }
 
@@ -29,6 +42,11 @@ bool Texture::isDefault() const
 	return mDefault;
 }
 
+bool Texture::isPlaceholder() const
+{
+	return !mDefaultTexture.isNull();
+}
+
 QSize Texture::getSize() const
 {
 	return mSize;
@@ -44,29 +62,40 @@ int Texture::getHeight() const
 	return mSize.height();
 }
 
-void Texture::draw()
+GLuint Texture::getHandle() const
 {
-	glBindTexture(GL_TEXTURE_2D, mHandle);
-	glBegin(GL_TRIANGLE_STRIP);
-	glTexCoord2d(0.0, 0.0);
-	glVertex2d(0.0, mSize.height());
-	glTexCoord2d(1.0, 0.0);
-	glVertex2d(mSize.width(), mSize.height());
-	glTexCoord2d(0.0, 1.0);
-	glVertex2d(0.0, 0.0);
-	glTexCoord2d(1.0, 1.0);
-	glVertex2d(mSize.width(), 0.0);
-	glEnd();
+	return mHandle;
 }
 
-void Texture::load(const QString &fileName)
+QImage Texture::decodeImage(const QString &fileName)
 {
-	// загружаем изображение из файла
+	// загружаем изображение из файла и приводим его к 32-битному формату
 	QImage image(fileName);
-	if (!image.isNull())
+	if (image.isNull())
+		return QImage();
+	if (image.format() != QImage::Format_ARGB32 && image.format() != QImage::Format_RGB32)
+		image = image.convertToFormat(image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+
+	// переставляем байты пикселей в порядок RGBA прямо в буфере изображения без переворота по вертикали,
+	// текстурные координаты при отрисовке отсчитываются от верхней строки изображения
+	bool opaque = image.format() == QImage::Format_RGB32;
+	for (int y = 0; y < image.height(); ++y)
+	{
+		quint32 *line = reinterpret_cast<quint32 *>(image.scanLine(y));
+		PixelConverter::convertToRGBA(line, line, image.width(), opaque, false);
+	}
+	return image;
+}
+
+void Texture::load(const QString &fileName)
+{
+	upload(decodeImage(fileName));
+}
+
+void Texture::upload(const QImage &GLImage)
+{
+	if (!GLImage.isNull())
 	{
-		// конвертируем изображение в формат, подходящий для OpenGL
-		QImage GLImage = QGLWidget::convertToGLFormat(image);
 		mSize = GLImage.size();
 
 		// создаем текстуру
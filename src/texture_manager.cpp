@@ -1,44 +1,49 @@
 #include "pch.h"
 #include "texture_manager.h"
 #include "texture_loader.h"
+#include "directory_cache.h"
+#include "project.h"
+#include "utils.h"
 
 template<> TextureManager *Singleton<TextureManager>::mSingleton = NULL;
 
-TextureManager::TextureManager(QGLWidget *primaryGLWidget, QGLWidget *secondaryGLWidget)
+TextureManager::TextureManager(QGLWidget *primaryGLWidget)
 : mPrimaryGLWidget(primaryGLWidget)
 {
-	// создаем фоновый поток
-	mBackgroundThread = new QThread(this);
+	// создаем пул потоков для декодирования изображений по количеству ядер процессора
+	mDecodePool = new QThreadPool(this);
+	mDecodePool->setMaxThreadCount(QThread::idealThreadCount());
 
-	// создаем загрузчик текстур и переносим его в фоновый поток
-	mTextureLoader = new TextureLoader(secondaryGLWidget);
-	qRegisterMetaType<QSharedPointer<Texture> >("QSharedPointer<Texture>");
-	connect(this, SIGNAL(textureQueued(QString)), mTextureLoader, SLOT(onTextureQueued(QString)));
-	connect(mTextureLoader, SIGNAL(textureLoaded(QString, QSharedPointer<Texture>)), this, SLOT(onTextureLoaded(QString, QSharedPointer<Texture>)));
-	mTextureLoader->moveToThread(mBackgroundThread);
+	// создаем таймер загрузки декодированных изображений в OpenGL
+	mUploadTimer = new QTimer(this);
+	mUploadTimer->setInterval(UPLOAD_INTERVAL);
+	connect(mUploadTimer, SIGNAL(timeout()), this, SLOT(onUploadTimeout()));
 
 	// создаем объект слежения за файловой системой
 	mWatcher = new QFileSystemWatcher(this);
 	connect(mWatcher, SIGNAL(fileChanged(const QString &)), this, SLOT(onFileChanged(const QString &)));
+	connect(mWatcher, SIGNAL(directoryChanged(const QString &)), this, SLOT(onDirectoryChanged(const QString &)));
 
-	// запускаем фоновый поток
-	mBackgroundThread->start();
+	// создаем таймер перезагрузки измененных файлов, перезапускаемый при каждом изменении
+	mChangeTimer = new QTimer(this);
+	mChangeTimer->setSingleShot(true);
+	mChangeTimer->setInterval(CHANGE_DELAY);
+	connect(mChangeTimer, SIGNAL(timeout()), this, SLOT(onChangeTimeout()));
 
-	// запускаем таймер для отслеживания изменений файлов
-	startTimer(250);
+	// запускаем таймер для удаления неиспользуемых текстур из кэша
+	startTimer(PRUNE_INTERVAL);
 }
 
 TextureManager::~TextureManager()
 {
-	// дожидаемся завершения фонового потока
-	mBackgroundThread->quit();
-	mBackgroundThread->wait();
+	// дожидаемся завершения задач декодирования, обращающихся к менеджеру
+	mDecodePool->waitForDone();
 
-	// удаляем загрузчик текстур
-	delete mTextureLoader;
+	// устанавливаем контекст OpenGL для удаления текстуры по умолчанию
+	mPrimaryGLWidget->makeCurrent();
 }
 
-QSharedPointer<Texture> TextureManager::loadTexture(const QString &fileName, bool useDefaultTexture)
+QSharedPointer<Texture> TextureManager::loadTexture(const QString &fileName, bool useDefaultTexture, bool async)
 {
 	// сначала ищем текстуру в кэше
 	TextureCache::iterator it = mTextureCache.find(fileName);
@@ -53,21 +58,33 @@ QSharedPointer<Texture> TextureManager::loadTexture(const QString &fileName, boo
 	// не нашли в кэше - загружаем текстуру из файла
 	QSharedPointer<Texture> texture;
 	QString path = Project::getSingleton().getRootDirectory() + fileName;
+	bool exists = Utils::fileExists(path);
+	QSize size;
 	mPrimaryGLWidget->makeCurrent();
-	if (Utils::fileExists(path) && (texture = QSharedPointer<Texture>(new Texture(path)))->isLoaded())
+	if (async && useDefaultTexture && exists && (size = QImageReader(path).size()).isValid())
 	{
-		// добавляем файл на слежение
-		if (!mWatcher->files().contains(path))
-			mWatcher->addPath(path);
+		// возвращаем заглушку с размерами из заголовка изображения и отправляем файл на декодирование
+		if (mDefaultTexture.isNull())
+			mDefaultTexture = QSharedPointer<Texture>(new Texture());
+		texture = QSharedPointer<Texture>(new Texture(size, mDefaultTexture));
+		mTextureCache.insert(fileName, TextureInfo(texture));
+		watchTexture(path, false);
+		queueTexture(fileName, false);
+	}
+	else if (exists && (texture = QSharedPointer<Texture>(new Texture(path)))->isLoaded())
+	{
+		// добавляем файл и его каталог на слежение
+		watchTexture(path, true);
 
 		// добавляем текстуру в кэш
 		mTextureCache.insert(fileName, TextureInfo(texture));
 	}
 	else if (useDefaultTexture)
 	{
-		// возвращаем текстуру по умолчанию
+		// возвращаем текстуру по умолчанию, следя за каталогом на случай появления файла
 		texture = QSharedPointer<Texture>(new Texture());
 		mTextureCache.insert(fileName, TextureInfo(texture));
+		watchTexture(path, false);
 	}
 	else
 	{
@@ -85,41 +102,33 @@ void TextureManager::makeCurrent()
 
 void TextureManager::timerEvent(QTimerEvent *event)
 {
-	// обновляем состояние всех текстур в кэше
+	// удаляем неиспользуемые текстуры из кэша и собираем каталоги оставшихся текстур
+	QString rootDirectory = Project::getSingleton().getRootDirectory();
+	QSet<QString> directories;
 	TextureCache::iterator it = mTextureCache.begin();
 	while (it != mTextureCache.end())
 	{
-		QString path = Project::getSingleton().getRootDirectory() + it.key();
+		QString path = rootDirectory + it.key();
 		if (!it->mTexture.isNull())
 		{
-			if (it->mTexture.toStrongRef()->isDefault())
-			{
-				// если файл текстуры был удален, а потом восстановлен, отправляем текстуру на загрузку
-				if (Utils::fileExists(path))
-					emit textureQueued(it.key());
-			}
-			else if (it->mChanged)
-			{
-				// если с момента последнего изменения текстуры прошло достаточно много времени, отправляем ее на загрузку
-				if (it->mTimer.hasExpired(250))
-				{
-					it->mChanged = false;
-					if (Utils::fileExists(path))
-						emit textureQueued(it.key());
-					else
-						onTextureLoaded(it.key(), QSharedPointer<Texture>());
-				}
-			}
+			directories.insert(QFileInfo(path).absolutePath());
 			++it;
 		}
 		else
 		{
-			// удаляем неиспользуемую текстуру из кэша
-			if (mWatcher->files().contains(path))
+			if (mWatchedFiles.remove(path))
 				mWatcher->removePath(path);
+			mChangedTextures.remove(it.key());
 			mTextureCache.erase(it++);
 		}
 	}
+
+	// снимаем со слежения каталоги, в которых не осталось текстур
+	foreach (const QString &directory, mWatchedDirectories - directories)
+	{
+		mWatchedDirectories.remove(directory);
+		mWatcher->removePath(directory);
+	}
 }
 
 void TextureManager::onFileChanged(const QString &path)
@@ -129,12 +138,57 @@ void TextureManager::onFileChanged(const QString &path)
 	TextureCache::iterator it = mTextureCache.find(fileName);
 	if (it != mTextureCache.end() && !it->mTexture.isNull())
 	{
-		// помечаем текстуру как измененную
-		it->mChanged = true;
-		it->mTimer.start();
+		// откладываем перезагрузку, пока файл не перестанет изменяться
+		mChangedTextures.insert(fileName);
+		mChangeTimer->start();
+	}
+}
+
+void TextureManager::onDirectoryChanged(const QString &path)
+{
+	// сбрасываем закэшированное содержимое каталога, не дожидаясь уведомления самого кэша
+	DirectoryCache::getSingleton().invalidate(path);
+
+	// отправляем на загрузку текстуры по умолчанию, файлы которых появились в каталоге
+	QString rootDirectory = Project::getSingleton().getRootDirectory();
+	for (TextureCache::iterator it = mTextureCache.begin(); it != mTextureCache.end(); ++it)
+	{
+		QSharedPointer<Texture> texture = it->mTexture.toStrongRef();
+		if (!texture.isNull() && texture->isDefault())
+		{
+			QString texturePath = rootDirectory + it.key();
+			if (QFileInfo(texturePath).absolutePath() == path && Utils::fileExists(texturePath))
+				queueTexture(it.key(), false);
+		}
 	}
 }
 
+void TextureManager::onChangeTimeout()
+{
+	// отправляем на загрузку измененные файлы и заменяем текстуры удаленных файлов текстурой по умолчанию
+	QString rootDirectory = Project::getSingleton().getRootDirectory();
+	foreach (const QString &fileName, mChangedTextures)
+	{
+		QString path = rootDirectory + fileName;
+		if (Utils::fileExists(path))
+		{
+			// файл мог быть заменен новым, поэтому ставим его на слежение заново
+			mWatcher->removePath(path);
+			mWatcher->addPath(path);
+			mWatchedFiles.insert(path);
+			queueTexture(fileName, true);
+		}
+		else
+		{
+			if (mWatchedFiles.remove(path))
+				mWatcher->removePath(path);
+			onTextureLoaded(fileName, QSharedPointer<Texture>());
+		}
+	}
+	mChangedTextures.clear();
+	emitTexturesChanged();
+}
+
 void TextureManager::onTextureLoaded(QString fileName, QSharedPointer<Texture> texture)
 {
 	// проверяем, используется ли текстура игровыми объектами
@@ -143,17 +197,112 @@ void TextureManager::onTextureLoaded(QString fileName, QSharedPointer<Texture> t
 	{
 		// добавляем файл на слежение
 		if (!texture.isNull())
-		{
-			QString path = Project::getSingleton().getRootDirectory() + fileName;
-			if (!mWatcher->files().contains(path))
-				mWatcher->addPath(path);
-		}
+			watchTexture(Project::getSingleton().getRootDirectory() + fileName, true);
 
-		// выдаем сигнал об изменении текстуры и заменяем ее в кэше
+		// откладываем замену текстуры до выдачи общего сигнала для всех загруженных текстур
 		mPrimaryGLWidget->makeCurrent();
-		QSharedPointer<Texture> newTexture = !texture.isNull() ? texture : QSharedPointer<Texture>(new Texture());
-		emit textureChanged(fileName, newTexture);
-		Q_ASSERT(it->mTexture.isNull());
-		it->mTexture = newTexture;
+		mLoadedTextures.insert(fileName, !texture.isNull() ? texture : QSharedPointer<Texture>(new Texture()));
+	}
+}
+
+void TextureManager::onImageDecoded(QString fileName, QImage image)
+{
+	// если файл изменился во время декодирования, отбрасываем устаревшее изображение и декодируем файл заново
+	if (mDecodingTextures.take(fileName))
+	{
+		queueTexture(fileName, true);
+		return;
+	}
+
+	// ставим изображение в очередь на загрузку в OpenGL, заменяя более старое изображение того же файла
+	mDecodedImages.insert(fileName, image);
+	if (!mUploadTimer->isActive())
+		mUploadTimer->start();
+}
+
+void TextureManager::onUploadTimeout()
+{
+	// загружаем декодированные изображения в OpenGL, пока не истечет время, отведенное на интервал
+	QElapsedTimer timer;
+	timer.start();
+	mPrimaryGLWidget->makeCurrent();
+	while (!mDecodedImages.empty() && !timer.hasExpired(UPLOAD_TIME_BUDGET))
+	{
+		// извлекаем изображение из очереди
+		QMap<QString, QImage>::iterator it = mDecodedImages.begin();
+		QString fileName = it.key();
+		QImage image = *it;
+		mDecodedImages.erase(it);
+
+		// создаем текстуру и заменяем ею текстуру в кэше
+		QSharedPointer<Texture> texture;
+		if (!image.isNull() && !(texture = QSharedPointer<Texture>(new Texture(image)))->isLoaded())
+			texture.clear();
+		onTextureLoaded(fileName, texture);
+	}
+
+	// заменяем все загруженные за интервал текстуры разом, чтобы окна обновлялись один раз за интервал
+	emitTexturesChanged();
+
+	// останавливаем таймер, если очередь пуста
+	if (mDecodedImages.empty())
+		mUploadTimer->stop();
+}
+
+void TextureManager::queueTexture(const QString &fileName, bool changed)
+{
+	// если файл уже декодируется, помечаем его для повторного декодирования при изменении
+	QHash<QString, bool>::iterator it = mDecodingTextures.find(fileName);
+	if (it != mDecodingTextures.end())
+	{
+		if (changed)
+			*it = true;
+		return;
+	}
+
+	// не декодируем неизмененный файл повторно, если его изображение ожидает загрузки в OpenGL
+	if (!changed && mDecodedImages.contains(fileName))
+		return;
+
+	// отправляем файл на декодирование в пул потоков
+	mDecodingTextures.insert(fileName, false);
+	mDecodePool->start(new TextureLoader(this, fileName, Project::getSingleton().getRootDirectory() + fileName));
+}
+
+void TextureManager::watchTexture(const QString &path, bool watchFile)
+{
+	// следим за каталогом, чтобы узнавать о появлении и удалении файлов без опроса диска
+	QString directory = QFileInfo(path).absolutePath();
+	if (!mWatchedDirectories.contains(directory))
+	{
+		mWatchedDirectories.insert(directory);
+		mWatcher->addPath(directory);
+	}
+
+	// следим за самим файлом, чтобы узнавать об изменении его содержимого
+	if (watchFile && !mWatchedFiles.contains(path))
+	{
+		mWatchedFiles.insert(path);
+		mWatcher->addPath(path);
+	}
+}
+
+void TextureManager::emitTexturesChanged()
+{
+	if (mLoadedTextures.empty())
+		return;
+
+	// выдаем сигнал об изменении текстур и заменяем их в кэше
+	TextureMap textures = mLoadedTextures;
+	mLoadedTextures.clear();
+	emit texturesChanged(textures);
+	for (TextureMap::const_iterator it = textures.begin(); it != textures.end(); ++it)
+	{
+		TextureCache::iterator cacheIt = mTextureCache.find(it.key());
+		if (cacheIt != mTextureCache.end())
+		{
+			Q_ASSERT(cacheIt->mTexture.isNull());
+			cacheIt->mTexture = *it;
+		}
 	}
 }
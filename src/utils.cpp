@@ -1,5 +1,16 @@
 #include "pch.h"
 #include "utils.h"
+#include "directory_cache.h"
+
+#include <cmath>
+
+#ifdef Q_OS_WIN
+#include <io.h>
+#include <windows.h>
+#else
+#include <cstdio>
+#include <unistd.h>
+#endif
 
 const qreal Utils::PI = 3.14159265358979323846;
 const qreal Utils::EPS = 0.0001;
@@ -76,6 +87,11 @@ bool Utils::isFileNameValid(const QString &fileName, const QString &dir, QWidget
 
 bool Utils::fileExists(const QString &path)
 {
+	// проверяем существование файла по кэшу содержимого каталогов
+	DirectoryCache *cache = DirectoryCache::getSingletonPtr();
+	if (cache != NULL)
+		return cache->fileExists(path);
+
 	// проверяем, что файл существует с точностью до регистра символов
 	if (QFile::exists(path))
 	{
@@ -126,3 +142,110 @@ void Utils::writeFileHeader(QTextStream &stream)
 	stream << "-- All changes made in this file will be lost. DO NOT EDIT!" << endl;
 	stream << "-- *****************************************************************************" << endl;
 }
+
+void Utils::writeReal(QTextStream &stream, qreal value)
+{
+	// значения вне диапазона быстрого форматирования записываем стандартным форматированием потока
+	qreal absValue = qAbs(value);
+	if (value != 0.0 && !(absValue >= 1.0 && absValue < 1e8))
+	{
+		stream << value;
+		return;
+	}
+
+	// определяем количество знаков после запятой, оставляя 8 значащих цифр
+	static const qint64 powers[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+	int numDecimals = 8;
+	while (numDecimals > 0 && absValue >= powers[8 - numDecimals])
+		--numDecimals;
+
+	// округляем до ближайшего целого, а точную середину - к четному, как стандартное форматирование потока;
+	// произведение вычисляется с округлением, поэтому для середины направление уточняется по знаку его погрешности
+	qreal power = static_cast<qreal>(powers[numDecimals]);
+	qreal product = absValue * power;
+	qreal floorValue = std::floor(product);
+	qint64 scaled = static_cast<qint64>(floorValue);
+	qreal rest = product - floorValue;
+	if (rest == 0.5)
+	{
+		qreal error = std::fma(absValue, power, -product);
+		if (error > 0.0 || (error == 0.0 && scaled % 2 != 0))
+			++scaled;
+	}
+	else if (rest > 0.5)
+	{
+		++scaled;
+	}
+
+	// значение, округленное до 1E+08, стандартное форматирование записывает в экспоненциальной форме
+	if (numDecimals == 0 && scaled == powers[8])
+	{
+		stream << value;
+		return;
+	}
+
+	// разбиваем округленное значение на целую и дробную части
+	qint64 intPart = scaled / powers[numDecimals];
+	qint64 fracPart = scaled % powers[numDecimals];
+
+	// отбрасываем незначащие нули дробной части
+	int numFracDigits = numDecimals;
+	while (numFracDigits > 0 && fracPart % 10 == 0)
+	{
+		fracPart /= 10;
+		--numFracDigits;
+	}
+
+	// записываем цифры с конца буфера
+	char buffer[32];
+	char *ptr = buffer + sizeof(buffer);
+	*--ptr = '\0';
+	if (numFracDigits > 0)
+	{
+		for (int i = 0; i < numFracDigits; ++i, fracPart /= 10)
+			*--ptr = '0' + fracPart % 10;
+		*--ptr = '.';
+	}
+	do
+	{
+		*--ptr = '0' + intPart % 10;
+		intPart /= 10;
+	}
+	while (intPart != 0);
+	if (value < 0.0 && scaled != 0)
+		*--ptr = '-';
+
+	stream << QLatin1String(ptr);
+}
+
+bool Utils::writeFileAtomically(const QString &fileName, const QByteArray &data)
+{
+	// записываем данные во временный файл в том же каталоге
+	QString tempFileName = fileName + ".tmp";
+	QFile file(tempFileName);
+	if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size() || !file.flush())
+	{
+		file.close();
+		QFile::remove(tempFileName);
+		return false;
+	}
+
+	// сбрасываем данные на диск, чтобы после сбоя не получить замененный, но пустой файл
+#ifdef Q_OS_WIN
+	_commit(file.handle());
+#else
+	fsync(file.handle());
+#endif
+	file.close();
+
+	// атомарно заменяем исходный файл временным; rename в Windows не заменяет существующий файл
+#ifdef Q_OS_WIN
+	bool result = MoveFileExW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(tempFileName).utf16()),
+		reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(fileName).utf16()), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool result = rename(QFile::encodeName(tempFileName).constData(), QFile::encodeName(fileName).constData()) == 0;
+#endif
+	if (!result)
+		QFile::remove(tempFileName);
+	return result;
+}